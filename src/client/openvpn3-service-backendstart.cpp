@@ -28,13 +28,24 @@
  *         service is supposed to be automatically started by D-Bus, with
  *         root privileges.  This ensures the client process this service
  *         starts also runs with the appropriate privileges.
+ *
+ *         With the --warm-pool <size> option, a number of client processes
+ *         are started in advance.  These wait on the D-Bus for a token,
+ *         which StartClient hands over to an idle client process.
  */
 
 
+#include <deque>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <spawn.h>
+#include <sys/wait.h>
 
 #include "config.h"
 #include "dbus/core.hpp"
+#include "dbus/connection-creds.hpp"
 #include "log/dbus-log.hpp"
 #include "common/utils.hpp"
 
@@ -136,7 +147,9 @@ public:
     BackendStarterObject(GDBusConnection *dbuscon, const std::string busname, const std::string objpath)
         : DBusObject(objpath),
           BackendStarterSignals(dbuscon, objpath),
-          dbuscon(dbuscon)
+          dbuscon(dbuscon),
+          creds(dbuscon),
+          warm_pool_size(0)
     {
         std::stringstream introspection_xml;
         introspection_xml << "<node name='" << objpath << "'>"
@@ -145,6 +158,9 @@ public:
                           << "          <arg type='s' name='token' direction='in'/>"
                           << "          <arg type='u' name='pid' direction='out'/>"
                           << "        </method>"
+                          << "        <method name='WarmClientReady'>"
+                          << "          <arg type='u' name='start_pid' direction='in'/>"
+                          << "        </method>"
                           << GetLogIntrospection()
                           << "    </interface>"
                           << "</node>";
@@ -157,6 +173,55 @@ public:
     {
         LogInfo("Shutting down");
         RemoveObject(dbuscon);
+
+        // Idle warm pool clients will not be used by anyone else
+        for (auto& wc : warm_clients)
+        {
+            kill(wc.pid, SIGTERM);
+        }
+
+        // Session tokens still being handed over to a warm pool client
+        // are answered with an error.  The main loop has stopped, so the
+        // completion callbacks will most likely never run; the WarmAssign
+        // objects are released here.  The callbacks only keep a weak
+        // reference, so they ignore calls completing later on.
+        for (auto& wa : warm_assigns)
+        {
+            if (wa->call)
+            {
+                wa->call->Cancel();
+            }
+            return_start_error(wa->invoc);
+        }
+        warm_assigns.clear();
+
+        // Stop watching client processes still starting up.  Pending
+        // StartClient calls are answered with an error.
+        std::set<guint> watches;
+        watches.swap(child_watches);
+        for (auto& w : watches)
+        {
+            g_source_remove(w);
+        }
+    }
+
+
+    /**
+     *  Keeps a number of client processes started and waiting for a
+     *  session token.  This avoids the start-up cost of a new client
+     *  process on each StartClient call.  While the warm pool is
+     *  enabled, the idle checker will not stop this service.
+     *
+     * @param size  Number of idle client processes to keep running
+     */
+    void EnableWarmPool(unsigned int size)
+    {
+        if (0 == warm_pool_size && size > 0)
+        {
+            IdleCheck_RefInc();
+        }
+        warm_pool_size = size;
+        refill_warm_pool();
     }
 
 
@@ -201,16 +266,48 @@ public:
             // from the request
             gchar *token;
             g_variant_get (params, "(s)", &token);
-            pid_t backend_pid = start_backend_process(token);
-            if (-1 == backend_pid)
+            if (!warm_clients.empty())
+            {
+                // The reply is sent once an idle client process has
+                // accepted the token
+                std::shared_ptr<WarmAssign> wa(new WarmAssign);
+                wa->invoc = invoc;
+                wa->token = std::string(token);
+                warm_assigns.insert(wa);
+                assign_warm_client(wa);
+            }
+            else if (-1 == start_backend_process(token, invoc))
+            {
+                // The reply is otherwise sent once the started
+                // process has completed its fork()
+                return_start_error(invoc);
+            }
+            g_free(token);
+            refill_warm_pool();
+        }
+        else if ("WarmClientReady" == method_name)
+        {
+            // A client process started by refill_warm_pool() is ready
+            // to be assigned a session token
+            guint32 start_pid = 0;
+            g_variant_get (params, "(u)", &start_pid);
+
+            auto p = warm_pending.find((pid_t) start_pid);
+            if (warm_pending.end() == p || 0 != creds.GetUID(sender))
             {
                 GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.backend",
-                                                              "Backend client process died");
+                                                              "Unknown warm pool client");
                 g_dbus_method_invocation_return_gerror(invoc, err);
                 g_error_free(err);
                 return;
             }
-            g_dbus_method_invocation_return_value(invoc, g_variant_new("(u)", backend_pid));
+            warm_pending.erase(p);
+
+            WarmClient wc;
+            wc.busname = sender;
+            wc.pid = creds.GetPID(sender);
+            warm_clients.push_back(wc);
+            g_dbus_method_invocation_return_value(invoc, NULL);
         }
     };
 
@@ -288,57 +385,287 @@ public:
 
 
 private:
+    /**
+     *  An idle client process in the warm pool
+     */
+    struct WarmClient
+    {
+        std::string busname;
+        pid_t pid;
+    };
+
+    /**
+     *  Seconds a started warm pool client may use to report back before
+     *  it is considered lost
+     */
+    static const gint64 warm_client_timeout = 30;
+
+    /**
+     *  Milliseconds an idle warm pool client may use to accept a session
+     *  token before the next idle client is tried
+     */
+    static const int warm_assign_timeout = 2000;
+
+    /**
+     *  A StartClient call waiting for an idle warm pool client to
+     *  accept the session token
+     */
+    struct WarmAssign
+    {
+        GDBusMethodInvocation *invoc;
+        std::string token;
+        DBusPendingCall::Ptr call;
+    };
+
+    /**
+     *  A started client process which has not yet completed its fork()
+     */
+    struct ChildStart
+    {
+        BackendStarterObject *starter;
+        GDBusMethodInvocation *invoc;
+        std::string token;
+        guint watch_id;
+    };
+
     GDBusConnection *dbuscon;
+    DBusConnectionCreds creds;
+    unsigned int warm_pool_size;
+    std::deque<WarmClient> warm_clients;
+    std::map<pid_t, gint64> warm_pending;
+    std::set<std::shared_ptr<WarmAssign>> warm_assigns;
+    std::set<guint> child_watches;
+
+
+    /**
+     *  Hands over a session token to an idle client in the warm pool.
+     *  The AssignSession call is done asynchronously, the StartClient
+     *  call is answered by warm_client_assigned() once the client process
+     *  has responded.  If no idle client process is left, a new client
+     *  process is started instead.
+     *
+     * @param wa  WarmAssign object of the StartClient call to complete
+     */
+    void assign_warm_client(std::shared_ptr<WarmAssign> wa)
+    {
+        while (!warm_clients.empty())
+        {
+            WarmClient wc = warm_clients.front();
+            warm_clients.pop_front();
+            try
+            {
+                DBusProxy client(dbuscon, wc.busname,
+                                 OpenVPN3DBus_interf_backends,
+                                 OpenVPN3DBus_rootp_backends_warm);
+                client.SetGDBusCallFlags(G_DBUS_CALL_FLAGS_NO_AUTO_START);
+                std::weak_ptr<WarmAssign> weak_wa(wa);
+                wa->call = client.CallAsync("AssignSession",
+                                            g_variant_new("(s)",
+                                                          wa->token.c_str()),
+                                            warm_assign_timeout,
+                                            [this, weak_wa, wc](DBusPendingCall& call)
+                                            {
+                                                // The WarmAssign object only
+                                                // exists while the starter does
+                                                std::shared_ptr<WarmAssign> wa = weak_wa.lock();
+                                                if (wa)
+                                                {
+                                                    warm_client_assigned(wa, wc, call);
+                                                }
+                                            });
+                return;
+            }
+            catch (DBusException& excp)
+            {
+                Debug(wc.busname, OpenVPN3DBus_rootp_backends_warm,
+                      "Warm pool client unavailable: " + excp.getRawError());
+            }
+        }
+
+        // No idle client process took the session token
+        warm_assigns.erase(wa);
+        if (-1 == start_backend_process(wa->token, wa->invoc))
+        {
+            return_start_error(wa->invoc);
+        }
+    }
+
+
+    /**
+     *  Completes a StartClient call when an idle warm pool client has
+     *  responded to the AssignSession call.  If the client process failed
+     *  or did not respond in time, the next idle client is tried.
+     *
+     * @param wa    WarmAssign object of the StartClient call
+     * @param wc    WarmClient which was given the session token
+     * @param call  DBusPendingCall of the completed AssignSession call
+     */
+    void warm_client_assigned(std::shared_ptr<WarmAssign> wa,
+                              const WarmClient& wc,
+                              DBusPendingCall& call)
+    {
+        wa->call.reset();
+        try
+        {
+            GVariant *res = call.GetResult();
+            g_variant_unref(res);
+
+            warm_assigns.erase(wa);
+            g_dbus_method_invocation_return_value(wa->invoc,
+                                                  g_variant_new("(u)", wc.pid));
+            return;
+        }
+        catch (DBusException& excp)
+        {
+            // The client process has most likely died.  If it just does
+            // not respond, ensure it will not pick up this session later on.
+            Debug(wc.busname, OpenVPN3DBus_rootp_backends_warm,
+                  "Warm pool client unavailable: " + excp.getRawError());
+            kill(wc.pid, SIGTERM);
+        }
+        assign_warm_client(wa);
+        refill_warm_pool();
+    }
 
 
     /**
-     * Forks out a child thread which starts the openvpn3-service-client
-     * process with the provided backend start token.
+     *  Starts new client processes until the warm pool is full.  Started
+     *  client processes which never reported back are forgotten.
+     */
+    void refill_warm_pool()
+    {
+        gint64 now = g_get_monotonic_time();
+        for (auto it = warm_pending.begin(); it != warm_pending.end(); )
+        {
+            if ((now - it->second) > warm_client_timeout * G_USEC_PER_SEC)
+            {
+                it = warm_pending.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        while ((warm_clients.size() + warm_pending.size()) < warm_pool_size)
+        {
+            pid_t pid = start_backend_process("--warm-pool", nullptr);
+            if (-1 == pid)
+            {
+                break;
+            }
+            warm_pending[pid] = now;
+        }
+    }
+
+
+    /**
+     * Starts a new openvpn3-service-client process with the provided
+     * backend start token.  This does not wait for the process; the
+     * client process will fork() again and the started process exits
+     * shortly after.  This is caught by _cb_child_exited(), which sends
+     * the reply to the StartClient call.
      *
      * @param token  String containing the start token identifying the session
      *               object this process is tied to.
-     * @return Returns the process ID (pid) of the child process.
+     * @param invoc  GDBusMethodInvocation of the StartClient call to reply
+     *               to when the process has started.  May be nullptr.
+     * @return Returns the process ID (pid) of the child process, or -1 if
+     *         the process could not be started.  If -1 is returned, no
+     *         reply has been sent to invoc.
      */
-    pid_t start_backend_process(char * token)
+    pid_t start_backend_process(const std::string token,
+                                GDBusMethodInvocation *invoc)
     {
-        pid_t backend_pid = fork();
-        if (0 == backend_pid)
-        {
-            // Child
-            char * const client_args[] = {
+        char * const client_args[] = {
 #ifdef DEBUG_VALGRIND
-                (char *) "/usr/bin/valgrind",
-                (char *) "--log-file=/tmp/valgrind.log",
+            (char *) "/usr/bin/valgrind",
+            (char *) "--log-file=/tmp/valgrind.log",
 #endif
-                (char *) LIBEXEC_PATH "/openvpn3-service-client",
-                token,
-                NULL };
-            execve(client_args[0], client_args, NULL);
-
-            // If execve() succeedes, the line below will not be executed at all.
-            // So if we come here, there must be an error.
-            std::cerr << "** Error starting " << client_args[0] << ": " << strerror(errno) << std::endl;
-        }
-        else if( backend_pid > 0)
+            (char *) LIBEXEC_PATH "/openvpn3-service-client",
+            (char *) token.c_str(),
+            NULL };
+        char * const client_env[] = { NULL };
+
+        // posix_spawn() does not duplicate the address space of this
+        // process, unlike a plain fork()
+        pid_t backend_pid = -1;
+        int r = posix_spawn(&backend_pid, client_args[0], NULL, NULL,
+                            client_args, client_env);
+        if (0 != r)
         {
-            // Parent
+            LogError("Failed starting " + std::string(client_args[0])
+                     + ": " + std::string(strerror(r)));
+            return -1;
+        }
+
+        ChildStart *child = new ChildStart;
+        child->starter = this;
+        child->invoc = invoc;
+        child->token = token;
+        child->watch_id = g_child_watch_add_full(G_PRIORITY_DEFAULT,
+                                                 backend_pid,
+                                                 _cb_child_exited,
+                                                 child,
+                                                 _cb_child_watch_destroy);
+        child_watches.insert(child->watch_id);
+        return backend_pid;
+    }
+
+
+    static void return_start_error(GDBusMethodInvocation *invoc)
+    {
+        GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.backend",
+                                                      "Backend client process died");
+        g_dbus_method_invocation_return_gerror(invoc, err);
+        g_error_free(err);
+    }
+
 
+    static void _cb_child_exited(GPid pid, gint status, gpointer data)
+    {
+        ChildStart *child = (ChildStart *) data;
+        BackendStarterObject *self = child->starter;
+        self->child_watches.erase(child->watch_id);
+
+        bool ok = (WIFEXITED(status) && 0 == WEXITSTATUS(status));
+        if (!ok)
+        {
             std::stringstream msg;
-            // Wait for the child process to exit, as the client process will fork again
-            int rc = -1;
-            int w = waitpid(backend_pid, &rc, 0);
-            if (-1 == w)
+            msg << "Child process ("  << child->token
+                << ") - pid " << pid
+                << " failed to start as expected (exit code: "
+                << std::to_string(status) << ")";
+            self->LogError(msg.str());
+            self->warm_pending.erase(pid);
+        }
+
+        if (child->invoc)
+        {
+            if (ok)
+            {
+                g_dbus_method_invocation_return_value(child->invoc,
+                                                      g_variant_new("(u)", pid));
+            }
+            else
             {
-                msg << "Child process ("  << token
-                    << ") - pid " << backend_pid
-                    << " failed to start as expected (exit code: "
-                    << std::to_string(rc) << ")";
-                LogError(msg.str());
-                return -1;
+                return_start_error(child->invoc);
             }
-            return backend_pid;
+            child->invoc = nullptr;
         }
-        throw std::runtime_error("Failed to fork() backend client process");
+        g_spawn_close_pid(pid);
+    }
+
+
+    static void _cb_child_watch_destroy(gpointer data)
+    {
+        ChildStart *child = (ChildStart *) data;
+        if (child->invoc)
+        {
+            // The process was never reaped; the starter is shutting down
+            return_start_error(child->invoc);
+        }
+        delete child;
     }
 };
 
@@ -363,7 +690,8 @@ public:
                OpenVPN3DBus_interf_backends),
           mainobj(nullptr),
           procsig(nullptr),
-          logfile("")
+          logfile(""),
+          warm_pool_size(0)
     {
     };
 
@@ -389,6 +717,18 @@ public:
     }
 
 
+    /**
+     *  Sets the number of idle client processes to keep running, ready
+     *  to take over a new session.  Must be called before Setup().
+     *
+     * @param size  Size of the warm pool.  0 disables the warm pool.
+     */
+    void SetWarmPoolSize(unsigned int size)
+    {
+        warm_pool_size = size;
+    }
+
+
     /**
      *  This callback is called when the service was successfully registered
      *  on the D-Bus.
@@ -412,6 +752,11 @@ public:
         {
             mainobj->IdleCheck_Register(idle_checker);
         }
+
+        if (warm_pool_size > 0)
+        {
+            mainobj->EnableWarmPool(warm_pool_size);
+        }
     };
 
 
@@ -449,6 +794,7 @@ private:
     BackendStarterObject * mainobj;
     ProcessSignalProducer * procsig;
     std::string logfile;
+    unsigned int warm_pool_size;
 };
 
 
@@ -457,16 +803,35 @@ int main(int argc, char **argv)
 {
     std::cout << get_version(argv[0]) << std::endl;
 
+    unsigned int warm_pool_size = 0;
+    if (3 == argc && std::string("--warm-pool") == argv[1])
+    {
+        try
+        {
+            warm_pool_size = std::stoul(argv[2]);
+        }
+        catch (std::exception&)
+        {
+            std::cerr << "** ERROR ** Invalid --warm-pool size" << std::endl;
+            return 1;
+        }
+    }
+    else if (1 != argc)
+    {
+        std::cerr << "Usage: " << argv[0] << " [--warm-pool <size>]" << std::endl;
+        return 1;
+    }
+
     GMainLoop *main_loop = g_main_loop_new(NULL, FALSE);
     g_unix_signal_add(SIGINT, stop_handler, main_loop);
     g_unix_signal_add(SIGTERM, stop_handler, main_loop);
 
     IdleCheck::Ptr idle_exit = new IdleCheck(main_loop,
                                              std::chrono::minutes(1));
-    idle_exit->SetPollTime(std::chrono::seconds(10));
 
     BackendStarterDBus backstart(G_BUS_TYPE_SYSTEM);
     backstart.EnableIdleCheck(idle_exit);
+    backstart.SetWarmPoolSize(warm_pool_size);
     backstart.Setup();
 
     idle_exit->Enable();
@@ -33,6 +33,7 @@
  *         connection.
  */
 
+#include <memory>
 #include <sstream>
 
 #include "common/core-extensions.hpp"
@@ -40,6 +41,7 @@
 #include "common/utils.hpp"
 #include "configmgr/proxy-configmgr.hpp"
 #include "dbus/core.hpp"
+#include "dbus/connection-creds.hpp"
 #include "dbus/path.hpp"
 #include "log/dbus-log.hpp"
 #include "backend-signals.hpp"
@@ -81,7 +83,8 @@ public:
           registered(false),
           paused(false),
           vpnclient(nullptr),
-          client_thread(nullptr)
+          client_thread(nullptr),
+          session_info(nullptr)
     {
         // Initialize the VPN Core
         CoreVPNClient::init_process();
@@ -93,10 +96,17 @@ public:
                           << "            <arg type='s' name='token' direction='in'/>"
                           << "            <arg type='o' name='config_path' direction='in'/>"
                           << "            <arg type='b' name='response' direction='out'/>"
+                          << "            <arg type='s' name='p2p_address' direction='out'/>"
                           << "        </method>"
                           << "        <method name='Ping'>"
                           << "            <arg type='b' name='alive' direction='out'/>"
                           << "        </method>"
+                          << "        <method name='StoreSessionInfo'>"
+                          << "            <arg type='a{sv}' name='info' direction='in'/>"
+                          << "        </method>"
+                          << "        <method name='FetchSessionInfo'>"
+                          << "            <arg type='a{sv}' name='info' direction='out'/>"
+                          << "        </method>"
                           << "        <method name='Ready'/>"
                           << "        <method name='Connect'/>"
                           << "        <method name='Pause'>"
@@ -126,6 +136,7 @@ public:
                           <<  "    </interface>"
                           <<  "</node>";
         ParseIntrospectionXML(introspection_xml);
+        register_methods();
 
         // Tell the session manager we are ready.  This
         // request will also carry the correct object path
@@ -141,6 +152,10 @@ public:
 
     ~BackendClientObject()
     {
+        if (session_info)
+        {
+            g_variant_unref(session_info);
+        }
         CoreVPNClient::uninit_process();
     }
 
@@ -160,25 +175,22 @@ public:
 
     /**
      *  Callback method which is called each time a D-Bus method call occurs
-     *  on this BackendClientObject.
+     *  on this BackendClientObject.  The method handlers are bound in
+     *  register_methods().
      *
-     * @param conn        D-Bus connection where the method call occurred
-     * @param sender      D-Bus bus name of the sender of the method call
-     * @param obj_path    D-Bus object path of the target object.
-     * @param intf_name   D-Bus interface of the method call
-     * @param method_name D-Bus method name to be executed
-     * @param params      GVariant Glib2 object containing the arguments for
-     *                    the method call
-     * @param invoc       GDBusMethodInvocation where the response/result of
-     *                    the method call will be returned.
+     * @param conn     D-Bus connection where the method call occurred
+     * @param sender   D-Bus bus name of the sender of the method call
+     * @param handler  The method handler to run
+     * @param params   GVariant Glib2 object containing the arguments for
+     *                 the method call
+     * @param invoc    GDBusMethodInvocation where the response/result of
+     *                 the method call will be returned.
      */
-    void callback_method_call(GDBusConnection *conn,
-                              const std::string sender,
-                              const std::string obj_path,
-                              const std::string intf_name,
-                              const std::string method_name,
-                              GVariant *params,
-                              GDBusMethodInvocation *invoc)
+    void callback_method_dispatch(GDBusConnection *conn,
+                                  const gchar *sender,
+                                  const MethodHandler& handler,
+                                  GVariant *params,
+                                  GDBusMethodInvocation *invoc)
     {
         // Ensure D-Bus method calls are serialized
         std::lock_guard<std::mutex> lg(guard);
@@ -203,297 +215,13 @@ public:
                 }
             }
 
-            if ("RegistrationConfirmation" == method_name)
-            {
-                // This is called by the session manager only, as an
-                // acknowledgement from the session manager that it has
-                // linked this client process to a valid session object which
-                // will be accessible for front-end users.
-                //
-                // With this call, we also get the D-Bus object path for the
-                // the VPN configuration profile to use.  This is used when
-                // retrieve the configuration profile from the configuration
-                // manager service through the fetch_configuration() call.
-                //
-                if (registered)
-                {
-                    THROW_DBUSEXCEPTION("BackendServiceObject",
-                                        "Backend service is already registered");
-                }
-
-                gchar *token = NULL;
-                gchar *cfgpath = NULL;
-                g_variant_get (params, "(so)", &token, &cfgpath);
-
-                registered = (session_token == std::string(token));
-                configpath = std::string(cfgpath);
-
-                signal.Debug("Registration confirmation: "
-                             + std::string(token) + " == "
-                             + std::string(session_token) + " => "
-                             + (registered ? "true" : "false"));
-                if (registered)
-                {
-                    g_dbus_method_invocation_return_value(invoc,
-                                                          g_variant_new("(b)", (bool) registered));
-
-                    // Fetch the configuration from the config-manager.
-                    // Since the configuration may be set up for single-use
-                    // only, we must keep this config as long as we're running
-                    fetch_configuration();
-
-                    // Sets initial state, which also allows us to early
-                    // report back back if more data is required to be
-                    // sent by the front-end interface.
-                    initialize_client();
-                }
-                else
-                {
-                    GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.be-registration",
-                                                                  "Invalid registration token");
-                    g_dbus_method_invocation_return_gerror(invoc, err);
-                    g_error_free(err);
-                }
-                return;
-            }
-            else if ("Ping" == method_name)
-            {
-                // This is a more narrow Ping test than what the D-Bus
-                // infrastructure provides.  This is a ping response from this
-                // specific object.
-                //
-                // The Ping caller is expected to just receive true.
-                g_dbus_method_invocation_return_value(invoc, g_variant_new("(b)", (bool) true));
-                return;
-            }
-            else if ("Ready" == method_name)
-            {
-                // This method should just exit without any result if everything is okay.
-                // If there are issues, return an error message
-                if (!userinputq.QueueAllDone())
-                {
-                    GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.ready",
-                                                                  "Missing user credentials");
-                    g_dbus_method_invocation_return_gerror(invoc, err);
-                    g_error_free(err);
-                }
-            }
-            else if ("Connect" == method_name)
-            {
-                // This starts the connection against a VPN server
-
-                if( !registered )
-                {
-                    THROW_DBUSEXCEPTION("BackendServiceObject", "Backend service is not initialized");
-                }
-
-                // This re-initializes the client object.  If we have already
-                // tried to connectbut got an AUTH_FAILED, either due to wrong
-                // credentials or a dynamic challenge from the server, we
-                // need to re-establish the vpnclient object.
-                initialize_client();
-
-                if (!userinputq.QueueAllDone())
-                {
-                    GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.backend",
-                                                                  "Required user input not provided");
-                    g_dbus_method_invocation_return_gerror(invoc, err);
-                    g_error_free(err);
-                    return;
-                }
-                signal.LogInfo("Starting connection: " + to_string(obj_path));
-                connect();
-            }
-            else if ("Disconnect" == method_name)
-            {
-                // Disconnect from the server.  This will also shutdown this
-                // process.
-
-                if (!registered || !vpnclient)
-                {
-                    THROW_DBUSEXCEPTION("BackendServiceObject", "Backend service is not initialized");
-                }
-
-                signal.LogInfo("Stopping connection: " + to_string(obj_path));
-                signal.StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_DISCONNECTING);
-                vpnclient->stop();
-                if (client_thread)
-                {
-                    client_thread->join();
-                }
-                signal.StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_DONE);
-
-                // Shutting down our selves.
-                RemoveObject(dbusconn);
-                if (mainloop)
-                {
-                    g_main_loop_quit(mainloop);
-                }
-                else
-                {
-                    kill(getpid(), SIGTERM);
-                }
-            }
-            else if ("UserInputQueueGetTypeGroup"  == method_name)
-            {
-                // Return an array of tuples of ClientAttentionTypes and
-                // ClientAttentionGroups which needs to be satisfied before
-                // we can attempt another reconnect.  This is all handled
-                // by the RequiresQueue.
-
-                try
-                {
-                    userinputq.QueueCheckTypeGroup(invoc);
-                }
-                catch (RequiresQueueException& excp)
-                {
-                    excp.GenerateDBusError(invoc);
-                }
-                return; // QueueCheckTypeGroup() have fed invoc with a result already
-            }
-            else if ("UserInputQueueFetch"  == method_name)
-            {
-                // Retrieves a specific RequiresQueue item which the front-end
-                // needs to satisfy.
-
-                try
-                {
-                    userinputq.QueueFetch(invoc, params);
-                }
-                catch (RequiresQueueException& excp)
-                {
-                    excp.GenerateDBusError(invoc);
-                }
-                return; // QueueFetch() have fed invoc with a result already
-            }
-            else if ("UserInputQueueCheck" == method_name)
-            {
-                // Retrieve the RequiresSlot IDs for a specific
-                // ClientAttentionType/ClientAttentionGroup which needs to be
-                // satisfied by the front-end.
-
-                userinputq.QueueCheck(invoc, params);
-                return; // QueueCheck() have fed invoc with a result already
-            }
-            else if ("UserInputProvide" == method_name)
-            {
-                // This is called each time a RequiresSlot gets an update
-                // with data from the front-end.
-
-                if (!registered)
-                {
-                    THROW_DBUSEXCEPTION("BackendServiceObject", "Backend service is not initialized");
-                }
-
-                if (userinputq.QueueDone(params))
-                {
-                    GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.backend",
-                                                                  "Credentials not needed");
-                    g_dbus_method_invocation_return_gerror(invoc, err);
-                    g_error_free(err);
-                    return;
-                }
-                userinputq.UpdateEntry(invoc, params);
-            }
-            else if ("Pause" == method_name)
-            {
-                // Pauses and suspends an on-going and connected VPN tunnel.
-                // The reason message provided with this call is sent to the
-                // log.
-
-                if( !registered || !vpnclient )
-                {
-                    THROW_DBUSEXCEPTION("BackendServiceObject", "Backend service is not initialized");
-                }
-
-                if (paused)
-                {
-                    GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.backend",
-                                                                  "Connection is already paused");
-                    g_dbus_method_invocation_return_gerror(invoc, err);
-                    g_error_free(err);
-                    return;
-                }
-
-                gchar *reason_str = NULL;
-                g_variant_get (params, "(s)", &reason_str);
-                std::string reason(reason_str);
-
-                signal.LogInfo("Pausing connection: " + to_string(obj_path));
-                signal.StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_PAUSING,
-                                    "Reason: " + reason);
-                vpnclient->pause(reason);
-                paused = true;
-                signal.StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_PAUSED);
-            }
-            else if ("Resume" == method_name)
-            {
-                // Resumes an already paused VPN session
-
-                if( !registered || !vpnclient )
-                {
-                    THROW_DBUSEXCEPTION("BackendServiceObject", "Backend service is not initialized");
-                }
-
-                if (!paused)
-                {
-                    GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.backend",
-                                                                  "Connection is not paused");
-                    g_dbus_method_invocation_return_gerror(invoc, err);
-                    g_error_free(err);
-                    return;
-                }
-
-                signal.LogInfo("Resuming connection: " + to_string(obj_path));
-                signal.StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_RESUMING);
-                vpnclient->resume();
-                paused = false;
-            }
-            else if ("Restart" == method_name)
-            {
-                // Does a complete re-connect for an already running VPN
-                // session.  This will reuse all the credentials already
-                // gathered.
-
-                if (!registered || !vpnclient)
-                {
-                    THROW_DBUSEXCEPTION("BackendServiceObject", "Backend service is not initialized");
-                }
-                signal.LogInfo("Restarting connection: " + to_string(obj_path));
-                signal.StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_RECONNECTING);
-                vpnclient->reconnect(0);
-            }
-            else if ("ForceShutdown" == method_name)
-            {
-                // This is an emergency break for this process.  This
-                // kills this process without considering if we are in
-                // an already running state.  This is primarily used to
-                // clean-up stray session objects which is considered dead
-                // by the session manager.
-
-                signal.LogInfo("Forcing shutdown of backend process: " + to_string(obj_path));
-                signal.StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_DONE);
-
-                // Shutting down our selves.
-                RemoveObject(dbusconn);
-                if (mainloop)
-                {
-                    g_main_loop_quit(mainloop);
-                }
-                else
-                {
-                    kill(getpid(), SIGTERM);
-                }
-            }
-            else
-            {
-                throw std::invalid_argument("Not implemented method");
-            }
-            g_dbus_method_invocation_return_value(invoc, NULL);
+            handler(conn, sender, params, invoc);
         }
         catch (const std::exception& excp)
         {
-            std::string errmsg = "Failed executing D-Bus call '" + method_name + "': " + excp.what();
+            std::string errmsg = "Failed executing D-Bus call '"
+                                 + std::string(g_dbus_method_invocation_get_method_name(invoc))
+                                 + "': " + excp.what();
             GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.backend.error.standard",
                                                           errmsg.c_str());
             g_dbus_method_invocation_return_gerror(invoc, err);
@@ -600,6 +328,435 @@ private:
     ClientAPI::ProvideCreds creds;
     RequiresQueue userinputq;
     std::mutex guard;
+    std::unique_ptr<DBusPeerServer> peer_server;
+    GVariant *session_info;
+
+
+    /**
+     *  Binds the handlers of all the D-Bus methods of this object.  These
+     *  are run via callback_method_dispatch().
+     */
+    void register_methods()
+    {
+        RegisterMethod("RegistrationConfirmation", "(so)",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+        {
+            // This is called by the session manager only, as an
+            // acknowledgement from the session manager that it has
+            // linked this client process to a valid session object which
+            // will be accessible for front-end users.
+            //
+            // With this call, we also get the D-Bus object path for the
+            // the VPN configuration profile to use.  This is used when
+            // retrieve the configuration profile from the configuration
+            // manager service through the fetch_configuration() call.
+            //
+            if (registered)
+            {
+                THROW_DBUSEXCEPTION("BackendServiceObject",
+                                    "Backend service is already registered");
+            }
+
+            gchar *token = NULL;
+            gchar *cfgpath = NULL;
+            g_variant_get (params, "(so)", &token, &cfgpath);
+
+            registered = (session_token == std::string(token));
+            configpath = std::string(cfgpath);
+
+            signal.Debug("Registration confirmation: "
+                         + std::string(token) + " == "
+                         + std::string(session_token) + " => "
+                         + (registered ? "true" : "false"));
+            g_free(token);
+            g_free(cfgpath);
+            if (registered)
+            {
+                // Offer the session manager a private connection to
+                // this object, which does not pass the D-Bus daemon
+                std::string p2p_address = start_peer_server(conn, sender);
+                g_dbus_method_invocation_return_value(invoc,
+                                                      g_variant_new("(bs)",
+                                                                    (bool) registered,
+                                                                    p2p_address.c_str()));
+
+                // Fetch the configuration from the config-manager.
+                // Since the configuration may be set up for single-use
+                // only, we must keep this config as long as we're running
+                fetch_configuration();
+
+                // Sets initial state, which also allows us to early
+                // report back back if more data is required to be
+                // sent by the front-end interface.
+                initialize_client();
+            }
+            else
+            {
+                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.be-registration",
+                                                              "Invalid registration token");
+                g_dbus_method_invocation_return_gerror(invoc, err);
+                g_error_free(err);
+            }
+        });
+
+        RegisterMethod("StoreSessionInfo", "(a{sv})",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+        {
+            // The session manager keeps a copy of its session object state
+            // here.  This allows a restarted session manager to re-attach
+            // to this process via FetchSessionInfo without disturbing
+            // the tunnel.
+            if (!registered)
+            {
+                THROW_DBUSEXCEPTION("BackendServiceObject",
+                                    "Backend service is not registered");
+            }
+            if (session_info)
+            {
+                g_variant_unref(session_info);
+            }
+            session_info = g_variant_get_child_value(params, 0);
+            g_dbus_method_invocation_return_value(invoc, NULL);
+        });
+
+        RegisterMethod("FetchSessionInfo", "()",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+        {
+            if (!session_info)
+            {
+                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.backend",
+                                                              "No session information stored");
+                g_dbus_method_invocation_return_gerror(invoc, err);
+                g_error_free(err);
+                return;
+            }
+            g_dbus_method_invocation_return_value(invoc,
+                                                  g_variant_new("(@a{sv})",
+                                                                session_info));
+        });
+
+        RegisterMethod("Ping", "()",
+                       [](GDBusConnection *conn, const gchar *sender,
+                          GVariant *params, GDBusMethodInvocation *invoc)
+        {
+            // This is a more narrow Ping test than what the D-Bus
+            // infrastructure provides.  This is a ping response from this
+            // specific object.
+            //
+            // The Ping caller is expected to just receive true.
+            g_dbus_method_invocation_return_value(invoc, g_variant_new("(b)", (bool) true));
+        });
+
+        RegisterMethod("Ready", "()",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+        {
+            // This method should just exit without any result if everything is okay.
+            // If there are issues, return an error message
+            if (!userinputq.QueueAllDone())
+            {
+                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.ready",
+                                                              "Missing user credentials");
+                g_dbus_method_invocation_return_gerror(invoc, err);
+                g_error_free(err);
+                return;
+            }
+            g_dbus_method_invocation_return_value(invoc, NULL);
+        });
+
+        RegisterMethod("Connect", "()",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+        {
+            // This starts the connection against a VPN server
+
+            if( !registered )
+            {
+                THROW_DBUSEXCEPTION("BackendServiceObject", "Backend service is not initialized");
+            }
+
+            // This re-initializes the client object.  If we have already
+            // tried to connectbut got an AUTH_FAILED, either due to wrong
+            // credentials or a dynamic challenge from the server, we
+            // need to re-establish the vpnclient object.
+            initialize_client();
+
+            if (!userinputq.QueueAllDone())
+            {
+                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.backend",
+                                                              "Required user input not provided");
+                g_dbus_method_invocation_return_gerror(invoc, err);
+                g_error_free(err);
+                return;
+            }
+            signal.LogInfo("Starting connection: " + GetObjectPath());
+            connect();
+            g_dbus_method_invocation_return_value(invoc, NULL);
+        });
+
+        RegisterMethod("Disconnect", "()",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+        {
+            // Disconnect from the server.  This will also shutdown this
+            // process.
+
+            if (!registered || !vpnclient)
+            {
+                THROW_DBUSEXCEPTION("BackendServiceObject", "Backend service is not initialized");
+            }
+
+            signal.LogInfo("Stopping connection: " + GetObjectPath());
+            signal.StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_DISCONNECTING);
+            vpnclient->stop();
+            if (client_thread)
+            {
+                client_thread->join();
+            }
+            signal.StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_DONE);
+
+            // Shutting down our selves.
+            shutdown_process();
+            g_dbus_method_invocation_return_value(invoc, NULL);
+        });
+
+        RegisterMethod("UserInputQueueGetTypeGroup", "()",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+        {
+            // Return an array of tuples of ClientAttentionTypes and
+            // ClientAttentionGroups which needs to be satisfied before
+            // we can attempt another reconnect.  This is all handled
+            // by the RequiresQueue.
+
+            try
+            {
+                // QueueCheckTypeGroup() feeds invoc with a result
+                userinputq.QueueCheckTypeGroup(invoc);
+            }
+            catch (RequiresQueueException& excp)
+            {
+                excp.GenerateDBusError(invoc);
+            }
+        });
+
+        RegisterMethod("UserInputQueueFetch", "(uuu)",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+        {
+            // Retrieves a specific RequiresQueue item which the front-end
+            // needs to satisfy.
+
+            try
+            {
+                // QueueFetch() feeds invoc with a result
+                userinputq.QueueFetch(invoc, params);
+            }
+            catch (RequiresQueueException& excp)
+            {
+                excp.GenerateDBusError(invoc);
+            }
+        });
+
+        RegisterMethod("UserInputQueueCheck", "(uu)",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+        {
+            // Retrieve the RequiresSlot IDs for a specific
+            // ClientAttentionType/ClientAttentionGroup which needs to be
+            // satisfied by the front-end.
+
+            // QueueCheck() feeds invoc with a result
+            userinputq.QueueCheck(invoc, params);
+        });
+
+        RegisterMethod("UserInputProvide", "(uuus)",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+        {
+            // This is called each time a RequiresSlot gets an update
+            // with data from the front-end.
+
+            if (!registered)
+            {
+                THROW_DBUSEXCEPTION("BackendServiceObject", "Backend service is not initialized");
+            }
+
+            if (userinputq.QueueDone(params))
+            {
+                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.backend",
+                                                              "Credentials not needed");
+                g_dbus_method_invocation_return_gerror(invoc, err);
+                g_error_free(err);
+                return;
+            }
+            userinputq.UpdateEntry(invoc, params);
+            g_dbus_method_invocation_return_value(invoc, NULL);
+        });
+
+        RegisterMethod("Pause", "(s)",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+        {
+            // Pauses and suspends an on-going and connected VPN tunnel.
+            // The reason message provided with this call is sent to the
+            // log.
+
+            if( !registered || !vpnclient )
+            {
+                THROW_DBUSEXCEPTION("BackendServiceObject", "Backend service is not initialized");
+            }
+
+            if (paused)
+            {
+                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.backend",
+                                                              "Connection is already paused");
+                g_dbus_method_invocation_return_gerror(invoc, err);
+                g_error_free(err);
+                return;
+            }
+
+            gchar *reason_str = NULL;
+            g_variant_get (params, "(s)", &reason_str);
+            std::string reason(reason_str);
+            g_free(reason_str);
+
+            signal.LogInfo("Pausing connection: " + GetObjectPath());
+            signal.StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_PAUSING,
+                                "Reason: " + reason);
+            vpnclient->pause(reason);
+            paused = true;
+            signal.StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_PAUSED);
+            g_dbus_method_invocation_return_value(invoc, NULL);
+        });
+
+        RegisterMethod("Resume", "()",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+        {
+            // Resumes an already paused VPN session
+
+            if( !registered || !vpnclient )
+            {
+                THROW_DBUSEXCEPTION("BackendServiceObject", "Backend service is not initialized");
+            }
+
+            if (!paused)
+            {
+                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.backend",
+                                                              "Connection is not paused");
+                g_dbus_method_invocation_return_gerror(invoc, err);
+                g_error_free(err);
+                return;
+            }
+
+            signal.LogInfo("Resuming connection: " + GetObjectPath());
+            signal.StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_RESUMING);
+            vpnclient->resume();
+            paused = false;
+            g_dbus_method_invocation_return_value(invoc, NULL);
+        });
+
+        RegisterMethod("Restart", "()",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+        {
+            // Does a complete re-connect for an already running VPN
+            // session.  This will reuse all the credentials already
+            // gathered.
+
+            if (!registered || !vpnclient)
+            {
+                THROW_DBUSEXCEPTION("BackendServiceObject", "Backend service is not initialized");
+            }
+            signal.LogInfo("Restarting connection: " + GetObjectPath());
+            signal.StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_RECONNECTING);
+            vpnclient->reconnect(0);
+            g_dbus_method_invocation_return_value(invoc, NULL);
+        });
+
+        RegisterMethod("ForceShutdown", "()",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+        {
+            // This is an emergency break for this process.  This
+            // kills this process without considering if we are in
+            // an already running state.  This is primarily used to
+            // clean-up stray session objects which is considered dead
+            // by the session manager.
+
+            signal.LogInfo("Forcing shutdown of backend process: " + GetObjectPath());
+            signal.StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_DONE);
+
+            // Shutting down our selves.
+            shutdown_process();
+            g_dbus_method_invocation_return_value(invoc, NULL);
+        });
+    }
+
+
+    /**
+     *  Starts the private peer-to-peer D-Bus server.  Only the user
+     *  running the session manager is allowed to connect.  Each peer
+     *  connection gets access to this object, just as on the system bus.
+     *
+     * @param conn    D-Bus connection the session manager called us from
+     * @param sender  D-Bus bus name of the session manager
+     *
+     * @return  Returns a std::string with the address of the peer-to-peer
+     *          server.  If the server could not be started, an empty
+     *          string is returned and only the system bus can be used.
+     */
+    std::string start_peer_server(GDBusConnection *conn, const gchar *sender)
+    {
+        try
+        {
+            DBusConnectionCreds creds(conn);
+            uid_t sessmgr_uid = creds.GetUID(sender);
+
+            peer_server.reset(new DBusPeerServer(sessmgr_uid,
+                                   [this](GDBusConnection *peercon)
+                                   {
+                                       RegisterPeerObject(peercon);
+                                   },
+                                   [this](GDBusConnection *peercon)
+                                   {
+                                       RemovePeerObject(peercon);
+                                   }));
+            peer_server->Start();
+            signal.Debug("Peer-to-peer server listening on "
+                         + peer_server->GetClientAddress());
+            return peer_server->GetClientAddress();
+        }
+        catch (DBusException& excp)
+        {
+            signal.LogWarn("Peer-to-peer connection unavailable: "
+                           + excp.getRawError());
+            peer_server.reset();
+            return "";
+        }
+    }
+
+
+    /**
+     *  Removes this object from the D-Bus and stops the main loop,
+     *  which will exit this process.
+     */
+    void shutdown_process()
+    {
+        RemoveObject(dbusconn);
+        if (mainloop)
+        {
+            g_main_loop_quit(mainloop);
+        }
+        else
+        {
+            kill(getpid(), SIGTERM);
+        }
+    }
 
 
     /**
@@ -796,9 +953,8 @@ private:
         // Retrieve confniguration
         signal.LogVerb2("Retrieving configuration from " + configpath);
 
-        auto cfg_proxy = new OpenVPN3ConfigurationProxy(G_BUS_TYPE_SYSTEM,
-                                                        configpath);
-        ProfileMergeFromString pm(cfg_proxy->GetConfig(), "",
+        OpenVPN3ConfigurationProxy cfg_proxy(G_BUS_TYPE_SYSTEM, configpath);
+        ProfileMergeFromString pm(cfg_proxy.GetConfig(), "",
                                   ProfileMerge::FOLLOW_NONE,
                                   ProfileParseLimits::MAX_LINE_SIZE,
                                   ProfileParseLimits::MAX_PROFILE_SIZE);
@@ -809,7 +965,117 @@ private:
 #endif
         vpnconfig.info = true;
         vpnconfig.content = pm.profile_content();
-        vpnconfig.tunPersist = cfg_proxy->GetPersistTun();
+        vpnconfig.tunPersist = cfg_proxy.GetPersistTun();
+    }
+};
+
+
+
+/**
+ *  Object available while this client process waits in the warm pool of
+ *  the openvpn3-service-backendstart service.  The process is already
+ *  running and registered on the D-Bus, and is only waiting for the
+ *  session token of the session it should serve.  Only the backend
+ *  starter, running as root, may assign a session.
+ */
+class BackendWarmObject : public DBusObject,
+                          public RC<thread_safe_refcount>
+{
+public:
+    typedef RCPtr<BackendWarmObject> Ptr;
+    typedef std::function<void(const std::string token)> AssignCallback;
+
+    /**
+     *  Initialize the BackendWarmObject
+     *
+     * @param conn       D-Bus connection this object is tied to
+     * @param objpath    D-Bus object path where to reach this instance
+     * @param assign_cb  AssignCallback called from the main loop once a
+     *                   session token has been assigned
+     */
+    BackendWarmObject(GDBusConnection *conn, std::string objpath,
+                      AssignCallback assign_cb)
+        : DBusObject(objpath),
+          creds(conn),
+          assign_cb(assign_cb),
+          assigned(false)
+    {
+        std::stringstream introspection_xml;
+        introspection_xml << "<node name='" << objpath << "'>"
+                          << "    <interface name='" << OpenVPN3DBus_interf_backends << "'>"
+                          << "        <method name='AssignSession'>"
+                          << "            <arg type='s' name='token' direction='in'/>"
+                          << "        </method>"
+                          <<  "    </interface>"
+                          <<  "</node>";
+        ParseIntrospectionXML(introspection_xml);
+
+        RegisterMethod("AssignSession", "(s)",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+        {
+            if (0 != creds.GetUID(sender) || assigned)
+            {
+                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.backend",
+                                                              "Session assignment rejected");
+                g_dbus_method_invocation_return_gerror(invoc, err);
+                g_error_free(err);
+                return;
+            }
+
+            gchar *tok = NULL;
+            g_variant_get (params, "(s)", &tok);
+            token = std::string(tok);
+            g_free(tok);
+            assigned = true;
+            g_dbus_method_invocation_return_value(invoc, NULL);
+
+            // The callback removes this object, which cannot be done
+            // while this method call is being processed.
+            g_idle_add(_cb_assign, this);
+        });
+    }
+
+
+    GVariant * callback_get_property(GDBusConnection *conn,
+                                     const std::string sender,
+                                     const std::string obj_path,
+                                     const std::string intf_name,
+                                     const std::string property_name,
+                                     GError **error)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Unknown property");
+        return NULL;
+    }
+
+
+    GVariantBuilder * callback_set_property(GDBusConnection *conn,
+                                            const std::string sender,
+                                            const std::string obj_path,
+                                            const std::string intf_name,
+                                            const std::string property_name,
+                                            GVariant *value,
+                                            GError **error)
+    {
+        THROW_DBUSEXCEPTION("BackendWarmObject", "set property not implemented");
+    }
+
+
+private:
+    DBusConnectionCreds creds;
+    AssignCallback assign_cb;
+    bool assigned;
+    std::string token;
+
+
+    static gboolean _cb_assign(gpointer this_ptr)
+    {
+        BackendWarmObject *obj = (BackendWarmObject *) this_ptr;
+
+        // Keep this object alive until the callback has returned
+        BackendWarmObject::Ptr self(obj);
+        obj->assign_cb(obj->token);
+        return G_SOURCE_REMOVE;
     }
 };
 
@@ -830,7 +1096,9 @@ public:
      *                   registered on the system or session bus.
      * @param sesstoken  String containing the session token provided via the
      *                   command line.  This is used when signalling back
-     *                   to the session manager.
+     *                   to the session manager.  If empty, this process
+     *                   joins the warm pool of the backend starter and
+     *                   waits for a session token to be assigned.
      */
     BackendClientDBus(pid_t start_pid, GBusType bus_type, std::string sesstoken)
         : DBus(bus_type,
@@ -841,14 +1109,19 @@ public:
           session_token(sesstoken),
           procsig(nullptr),
           be_obj(nullptr),
-          signal(nullptr)
+          warm_obj(nullptr),
+          signal(nullptr),
+          mainloop(nullptr)
     {
     };
 
     ~BackendClientDBus()
     {
-        procsig->ProcessChange(StatusMinor::PROC_STOPPED);
-        delete procsig;
+        if (procsig)
+        {
+            procsig->ProcessChange(StatusMinor::PROC_STOPPED);
+            delete procsig;
+        }
         //delete be_obj;
     }
 
@@ -862,6 +1135,7 @@ public:
      */
     void SetMainLoop(GMainLoop *ml)
     {
+        mainloop = ml;
         if (be_obj)
         {
             be_obj->SetMainLoop(ml);
@@ -887,21 +1161,12 @@ public:
      */
     void callback_bus_acquired()
     {
-        // Create a new OpenVPN3 client session object
-        object_path = generate_path_uuid(OpenVPN3DBus_rootp_backends_sessions, 'z');
-        be_obj.reset(new BackendClientObject(GetConnection(), GetBusName(), object_path, session_token));
-        be_obj->RegisterObject(GetConnection());
-
-        // Setup a signal object of the backend
-        signal = new BackendSignals(GetConnection(), LogGroup::BACKENDPROC, object_path);
-        signal->LogVerb1("Backend client process started as pid " + std::to_string(start_pid)
-                         + " re-initiated as pid " + std::to_string(getpid()));
-        signal->LogVerb2("BackendClientDBus registered on '" + GetBusName()
-                       + "': " + object_path);
-
-        procsig = new ProcessSignalProducer(GetConnection(), OpenVPN3DBus_interf_backends,
-                                            object_path, "VPN-Client");
-        procsig->ProcessChange(StatusMinor::PROC_STARTED);
+        if (session_token.empty())
+        {
+            join_warm_pool();
+            return;
+        }
+        start_session();
     }
 
 
@@ -940,7 +1205,92 @@ private:
     std::string object_path;
     ProcessSignalProducer * procsig;
     BackendClientObject::Ptr be_obj;
+    BackendWarmObject::Ptr warm_obj;
     BackendSignals *signal;
+    GMainLoop *mainloop;
+
+
+    /**
+     *  Registers this process as an idle client in the warm pool of the
+     *  backend starter.  The session is started once the backend starter
+     *  assigns a session token.
+     */
+    void join_warm_pool()
+    {
+        warm_obj.reset(new BackendWarmObject(GetConnection(),
+                                             OpenVPN3DBus_rootp_backends_warm,
+                                             [this](const std::string token)
+                                             {
+                                                 assign_session(token);
+                                             }));
+        warm_obj->RegisterObject(GetConnection());
+
+        try
+        {
+            DBusProxy starter(GetConnection(),
+                              OpenVPN3DBus_name_backends,
+                              OpenVPN3DBus_interf_backends,
+                              OpenVPN3DBus_rootp_backends);
+            starter.SetGDBusCallFlags(G_DBUS_CALL_FLAGS_NO_AUTO_START);
+            GVariant *res = starter.Call("WarmClientReady",
+                                         g_variant_new("(u)", (guint32) start_pid));
+            if (res)
+            {
+                g_variant_unref(res);
+            }
+        }
+        catch (DBusException& excp)
+        {
+            // Without a backend starter to hand out sessions, there is
+            // no reason to keep this process running
+            std::cerr << "** ERROR ** Could not join the warm pool: "
+                      << excp.what() << std::endl;
+            kill(getpid(), SIGTERM);
+        }
+    }
+
+
+    /**
+     *  Called when the backend starter has assigned a session token to
+     *  this warm pool client process
+     *
+     * @param token  String containing the session token
+     */
+    void assign_session(const std::string token)
+    {
+        warm_obj->RemoveObject(GetConnection());
+        warm_obj.reset();
+        session_token = token;
+        start_session();
+    }
+
+
+    /**
+     *  Creates the client session object, which registers itself with
+     *  the session manager using the session token
+     */
+    void start_session()
+    {
+        // Create a new OpenVPN3 client session object
+        object_path = generate_path_uuid(OpenVPN3DBus_rootp_backends_sessions, 'z');
+        be_obj.reset(new BackendClientObject(GetConnection(), GetBusName(), object_path, session_token));
+        be_obj->RegisterObject(GetConnection());
+
+        // Setup a signal object of the backend
+        signal = new BackendSignals(GetConnection(), LogGroup::BACKENDPROC, object_path);
+        signal->LogVerb1("Backend client process started as pid " + std::to_string(start_pid)
+                         + " re-initiated as pid " + std::to_string(getpid()));
+        signal->LogVerb2("BackendClientDBus registered on '" + GetBusName()
+                       + "': " + object_path);
+
+        procsig = new ProcessSignalProducer(GetConnection(), OpenVPN3DBus_interf_backends,
+                                            object_path, "VPN-Client");
+        procsig->ProcessChange(StatusMinor::PROC_STARTED);
+        if (mainloop)
+        {
+            be_obj->SetMainLoop(mainloop);
+        }
+    }
 };
 
 
@@ -948,7 +1298,7 @@ int main(int argc, char **argv)
 {
     if (argc !=2)
     {
-        std::cout << "** ERROR ** Invalid usage: " << argv[0] << " <session registration token>" << std::endl;
+        std::cout << "** ERROR ** Invalid usage: " << argv[0] << " <session registration token | --warm-pool>" << std::endl;
         std::cout << std::endl;
         std::cout << "            This program is not intended to be called manually from the command line" << std::endl;
         return 1;
@@ -967,7 +1317,11 @@ int main(int argc, char **argv)
     {
         std::cout << get_version(argv[0]) << std::endl;
 
-        BackendClientDBus backend_service(start_pid, G_BUS_TYPE_SYSTEM, std::string(argv[1]));
+        // When started for the warm pool, the session token is
+        // provided later on by the backend starter
+        std::string token(argv[1]);
+        BackendClientDBus backend_service(start_pid, G_BUS_TYPE_SYSTEM,
+                                          ("--warm-pool" != token ? token : ""));
         backend_service.Setup();
 
         // Main loop
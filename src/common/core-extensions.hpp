@@ -21,6 +21,9 @@
 #define OPENVPN3_CORE_EXTENSIONS
 
 #include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include <json/json.h>
 #include <openvpn/client/cliconstants.hpp>
 #include <openvpn/common/options.hpp>
@@ -60,21 +63,209 @@ namespace openvpn {
         return ret.str();
     }
 
+    /**
+     *  Appends a string value to a JSON document, quoted and escaped
+     *
+     * @param out    std::string with the JSON document being written
+     * @param value  std::string with the value to append
+     */
+    inline void json_append_string(std::string& out, const std::string& value)
+    {
+        static const char hex[] = "0123456789abcdef";
+
+        out += '"';
+        size_t start = 0;
+        for (size_t i = 0; i < value.size(); i++)
+        {
+            unsigned char c = (unsigned char) value[i];
+            if (c >= 0x20 && '"' != c && '\\' != c)
+            {
+                continue;
+            }
+
+            // Copy the characters not needing escaping in one go
+            out.append(value, start, i - start);
+            start = i + 1;
+            switch (c)
+            {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            default:
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 0x0f];
+            }
+        }
+        out.append(value, start, std::string::npos);
+        out += '"';
+    }
+
+
+    /**
+     *  Checks if an option argument would be split or interpreted by the
+     *  configuration file parser unless it is quoted
+     *
+     * @param arg  std::string with the argument to check
+     *
+     * @return  Returns true if the argument must be quoted
+     */
+    inline bool optparser_needs_quoting(const std::string& arg)
+    {
+        return arg.empty() || std::string::npos != arg.find_first_of(" \t\"\\'#;");
+    }
+
+
+    /**
+     *  Builds the argument part of a configuration file line from a JSON
+     *  array of option arguments, as written by OptionListJSON::json_export().
+     *  Arguments which would be split or interpreted by the configuration
+     *  file parser are quoted.
+     *
+     * @param optname  std::string with the option name
+     * @param args     Json::Value array with the arguments
+     *
+     * @return  Returns a std::string with the arguments
+     */
+    inline std::string optparser_json_args(const std::string& optname,
+                                           const Json::Value& args)
+    {
+        std::string ret;
+        for (Json::ArrayIndex i = 0; i < args.size(); i++)
+        {
+            std::string arg = args[i].asString();
+            if (optparser_inline_file(optname))
+            {
+                // Inline file content is written as-is
+                ret += arg;
+                continue;
+            }
+
+            if (i > 0)
+            {
+                ret += " ";
+            }
+            if (!optparser_needs_quoting(arg))
+            {
+                ret += arg;
+                continue;
+            }
+            ret += '"';
+            for (const char c : arg)
+            {
+                if ('"' == c || '\\' == c)
+                {
+                    ret += '\\';
+                }
+                ret += c;
+            }
+            ret += '"';
+        }
+        return ret;
+    }
+
+
     class OptionListJSON : public openvpn::OptionList
     {
     public:
-        std::string json_export()
+        /**
+         *  Exports the options as a JSON object, with one member per
+         *  option name in the order the options first appear.
+         *
+         *  An option used once with at most one argument is a string,
+         *  which is empty if the option has no arguments.  If that single
+         *  argument must be quoted in a configuration file, it is a one
+         *  element array instead, so the quoting is kept on import.  An
+         *  option used once with several arguments is an array of strings.  An option
+         *  used several times, such as remote, is an array with one array
+         *  of argument strings per occurrence.
+         *
+         *  The document is written directly into a single buffer, sized
+         *  up front from the option lengths.
+         *
+         * @param compact  If true, no whitespace is added for readability
+         *
+         * @return  Returns a std::string with the JSON document
+         */
+        std::string json_export(bool compact = false) const
         {
-            Json::Value outdata;
-
-            // FIXME: Looks very hacky
-            for(auto element : *this) {
-                outdata[element.ref(0)] = (element.size() > 1 ? element.ref(1) : "");
+            // Find all the occurrences of each option.  The option map
+            // of OptionList is not used, as it is not necessarily updated.
+            std::unordered_map<std::string, std::vector<size_t>> occurrences;
+            std::vector<size_t> first_seen;
+            size_t estimate = 4;
+            for (size_t i = 0; i < size(); i++)
+            {
+                const Option& opt = (*this)[i];
+                if (0 == opt.size())
+                {
+                    continue;
+                }
+                std::vector<size_t>& occ = occurrences[opt.ref(0)];
+                if (occ.empty())
+                {
+                    first_seen.push_back(i);
+                }
+                occ.push_back(i);
+                for (size_t j = 0; j < opt.size(); j++)
+                {
+                    estimate += opt.ref(j).size() + 8;
+                }
             }
 
-            std::stringstream output;
-            output << outdata;
-            return output.str();
+            std::string out;
+            out.reserve(estimate + estimate / 16);
+            out += '{';
+            for (size_t n = 0; n < first_seen.size(); n++)
+            {
+                const std::string& name = (*this)[first_seen[n]].ref(0);
+                const std::vector<size_t>& occ = occurrences[name];
+
+                if (n > 0)
+                {
+                    out += ',';
+                }
+                if (!compact)
+                {
+                    out += "\n    ";
+                }
+                json_append_string(out, name);
+                out += (compact ? ":" : ": ");
+
+                const Option& opt = (*this)[occ[0]];
+                if (1 == occ.size() && opt.size() <= 2
+                    && !single_arg_needs_quoting(opt))
+                {
+                    json_append_string(out, (opt.size() > 1 ? opt.ref(1) : ""));
+                }
+                else if (1 == occ.size())
+                {
+                    json_append_args(out, opt, compact);
+                }
+                else
+                {
+                    out += '[';
+                    for (size_t k = 0; k < occ.size(); k++)
+                    {
+                        if (k > 0)
+                        {
+                            out += (compact ? "," : ", ");
+                        }
+                        json_append_args(out, (*this)[occ[k]], compact);
+                    }
+                    out += ']';
+                }
+            }
+            if (!compact && !first_seen.empty())
+            {
+                out += '\n';
+            }
+            out += '}';
+            return out;
         }
 
         std::string string_export()
@@ -116,6 +307,38 @@ namespace openvpn {
 
             return cfgstr.str();
         }
+
+
+    private:
+        /**
+         *  Checks if the only argument of an option must be quoted in a
+         *  configuration file.  Inline file content is never quoted.
+         */
+        static bool single_arg_needs_quoting(const Option& opt)
+        {
+            return 2 == opt.size()
+                && !optparser_inline_file(opt.ref(0))
+                && optparser_needs_quoting(opt.ref(1));
+        }
+
+
+        /**
+         *  Appends the arguments of an option as a JSON array of strings
+         */
+        static void json_append_args(std::string& out, const Option& opt,
+                                     bool compact)
+        {
+            out += '[';
+            for (size_t i = 1; i < opt.size(); i++)
+            {
+                if (i > 1)
+                {
+                    out += (compact ? "," : ", ");
+                }
+                json_append_string(out, opt.ref(i));
+            }
+            out += ']';
+        }
     };
 
     class ProfileMergeJSON : public openvpn::ProfileMerge
@@ -139,7 +362,26 @@ namespace openvpn {
             for( Json::ValueIterator it = data.begin();
                  it != data.end(); ++it) {
                 std::string name = it.name();
-                config_str << optparser_mkline(name, data[name].asString());
+                const Json::Value& value = data[name];
+                if (!value.isArray())
+                {
+                    config_str << optparser_mkline(name, value.asString());
+                }
+                else if (value.size() > 0 && value[0].isArray())
+                {
+                    // Option used several times, one array of
+                    // arguments per occurrence
+                    for (Json::ArrayIndex i = 0; i < value.size(); i++)
+                    {
+                        config_str << optparser_mkline(name,
+                                                       optparser_json_args(name, value[i]));
+                    }
+                }
+                else
+                {
+                    config_str << optparser_mkline(name,
+                                                   optparser_json_args(name, value));
+                }
             }
             expand_profile(config_str.str(), "", openvpn::ProfileMerge::FOLLOW_NONE,
                            openvpn::ProfileParseLimits::MAX_LINE_SIZE,
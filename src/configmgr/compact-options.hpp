@@ -0,0 +1,278 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2018      OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2018      David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   compact-options.hpp
+ *
+ * @brief  Compact storage of parsed configuration profile options, where
+ *         identical strings are shared between all profiles
+ */
+
+#ifndef OPENVPN3_DBUS_CONFIGMGR_COMPACTOPTIONS_HPP
+#define OPENVPN3_DBUS_CONFIGMGR_COMPACTOPTIONS_HPP
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glib.h>
+
+#include <openvpn/common/options.hpp>
+
+namespace openvpn
+{
+    /**
+     *  Process wide pool of interned strings.  Each distinct string is
+     *  only kept once in memory, regardless of how many users it has.
+     *  The strings are looked up by a hash of their content, so large
+     *  values, such as inline CA certificates, are deduplicated as well.
+     *  A string is removed from the pool when the last user releases it.
+     */
+    class InternedStringPool
+    {
+    public:
+        typedef std::shared_ptr<const std::string> Str;
+
+        /**
+         *  Retrieve the process wide string pool
+         */
+        static InternedStringPool& Get()
+        {
+            // Never destroyed, as strings may be released after
+            // static objects have been destroyed at exit
+            static InternedStringPool *pool = new InternedStringPool();
+            return *pool;
+        }
+
+
+        /**
+         *  Retrieve the shared copy of a string.  The string is added to
+         *  the pool if it has not been seen before.
+         *
+         * @param value  std::string with the value to look up
+         *
+         * @return  Returns a Str reference to the shared string
+         */
+        Str Intern(const std::string& value)
+        {
+            size_t hash = std::hash<std::string>()(value);
+
+            // Strings found via the pool must be released after the
+            // lock, as releasing the last reference removes it from the
+            // pool
+            std::vector<Str> found;
+            std::lock_guard<std::mutex> guard(mtx);
+
+            auto range = pool.equal_range(hash);
+            for (auto it = range.first; it != range.second; ++it)
+            {
+                Str s = it->second.lock();
+                if (s && *s == value)
+                {
+                    return s;
+                }
+                found.push_back(s);
+            }
+
+            Str s(new std::string(value),
+                  [this, hash](const std::string *p)
+                  {
+                      release(hash);
+                      delete p;
+                  });
+            pool.emplace(hash, s);
+            return s;
+        }
+
+
+        /**
+         *  Retrieve the number of distinct strings in the pool
+         */
+        size_t size()
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            return pool.size();
+        }
+
+
+    private:
+        std::mutex mtx;
+        std::unordered_multimap<size_t, std::weak_ptr<const std::string>> pool;
+
+
+        InternedStringPool()
+        {
+        }
+
+
+        void release(size_t hash)
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            auto range = pool.equal_range(hash);
+            for (auto it = range.first; it != range.second; )
+            {
+                it = (it->second.expired() ? pool.erase(it) : std::next(it));
+            }
+        }
+    };
+
+
+    /**
+     *  Compact copy of a parsed OptionList.  All option names and values
+     *  are kept in a single array of interned strings per profile, so
+     *  strings used by many profiles, such as directive names and inline
+     *  CA certificates, only exist once in memory.
+     *
+     *  This form is used to keep profiles which are not in use.  The
+     *  options must be restored into an OptionList before being used.
+     */
+    class CompactOptionList
+    {
+    public:
+        CompactOptionList()
+        {
+        }
+
+
+        /**
+         *  Creates a compact copy of an OptionList
+         *
+         * @param opts  OptionList to copy
+         */
+        explicit CompactOptionList(const OptionList& opts)
+        {
+            InternedStringPool& pool = InternedStringPool::Get();
+            option_ends.reserve(opts.size());
+            for (const auto& opt : opts)
+            {
+                for (size_t i = 0; i < opt.size(); i++)
+                {
+                    tokens.push_back(pool.Intern(opt.ref(i)));
+                }
+                option_ends.push_back(tokens.size());
+            }
+            tokens.shrink_to_fit();
+        }
+
+
+        /**
+         *  Creates a compact copy of options serialized by Serialize()
+         *
+         * @param opts  GVariant object of the type aas
+         */
+        explicit CompactOptionList(GVariant *opts)
+        {
+            InternedStringPool& pool = InternedStringPool::Get();
+            option_ends.reserve(g_variant_n_children(opts));
+
+            GVariantIter *opts_it = g_variant_iter_new(opts);
+            GVariantIter *opt_it = nullptr;
+            while (g_variant_iter_next(opts_it, "as", &opt_it))
+            {
+                const gchar *elem = nullptr;
+                while (g_variant_iter_next(opt_it, "&s", &elem))
+                {
+                    tokens.push_back(pool.Intern(std::string(elem)));
+                }
+                g_variant_iter_free(opt_it);
+                option_ends.push_back(tokens.size());
+            }
+            g_variant_iter_free(opts_it);
+            tokens.shrink_to_fit();
+        }
+
+
+        /**
+         *  Checks if there are any options stored
+         */
+        bool empty() const
+        {
+            return option_ends.empty();
+        }
+
+
+        /**
+         *  Removes all the options, releasing the memory used
+         */
+        void clear()
+        {
+            std::vector<InternedStringPool::Str>().swap(tokens);
+            std::vector<uint32_t>().swap(option_ends);
+        }
+
+
+        /**
+         *  Restores the options into an OptionList.  The options are
+         *  appended to the options already present.
+         *
+         * @param opts  OptionList to restore the options into
+         */
+        void Restore(OptionList& opts) const
+        {
+            opts.reserve(opts.size() + option_ends.size());
+            size_t start = 0;
+            for (const auto end : option_ends)
+            {
+                Option opt;
+                for (size_t i = start; i < end; i++)
+                {
+                    opt.push_back(*tokens[i]);
+                }
+                opts.push_back(std::move(opt));
+                start = end;
+            }
+            opts.update_map();
+        }
+
+
+        /**
+         *  Serializes the options, as used by the profile store
+         *
+         * @return  Returns a floating GVariant reference of the type aas
+         */
+        GVariant * Serialize() const
+        {
+            GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("aas"));
+            size_t start = 0;
+            for (const auto end : option_ends)
+            {
+                g_variant_builder_open(bld, G_VARIANT_TYPE("as"));
+                for (size_t i = start; i < end; i++)
+                {
+                    g_variant_builder_add(bld, "s", tokens[i]->c_str());
+                }
+                g_variant_builder_close(bld);
+                start = end;
+            }
+            GVariant *ret = g_variant_builder_end(bld);
+            g_variant_builder_unref(bld);
+            return ret;
+        }
+
+
+    private:
+        std::vector<InternedStringPool::Str> tokens;
+        std::vector<uint32_t> option_ends;
+    };
+};
+
+#endif // OPENVPN3_DBUS_CONFIGMGR_COMPACTOPTIONS_HPP
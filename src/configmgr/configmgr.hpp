@@ -22,6 +22,9 @@
 
 #include <functional>
 #include <map>
+#include <cctype>
+#include <set>
+#include <unordered_map>
 #include <ctime>
 
 #include "common/core-extensions.hpp"
@@ -29,6 +32,8 @@
 #include "dbus/connection-creds.hpp"
 #include "dbus/exceptions.hpp"
 #include "log/dbus-log.hpp"
+#include "configmgr/profile-store.hpp"
+#include "configmgr/compact-options.hpp"
 
 using namespace openvpn;
 
@@ -136,7 +141,9 @@ public:
                                 "Specified alias is invalid");
         }
 
-        std::string introsp_xml ="<node name='" + new_obj_path + "'>"
+        // The object path is not part of the introspection document,
+        // which allows all aliases to share the parsed document
+        std::string introsp_xml ="<node>"
             "    <interface name='" + OpenVPN3DBus_interf_configuration + "'>"
             "        <property  type='o' name='config_path' access='read'/>"
             "    </interface>"
@@ -280,6 +287,8 @@ public:
      * @param dbuscon  D-Bus connection this object is tied to
      * @param remove_callback  Callback function which must be called when
      *                 destroying this configuration object.
+     * @param update_callback  Callback function which is called when the
+     *                 name or alias of this configuration object changes.
      * @param objpath  D-Bus object path of this object
      * @param creator  An uid reference of the owner of this object.  This is
      *                 typically the uid of the front-end user importing this
@@ -287,15 +296,22 @@ public:
      * @param params   Pointer to a GLib2 GVariant object containing both
      *                 meta data as well as the configuration profile itself
      *                 to use when initializing this object
+     * @param store    ConfigProfileStore where persistent profiles are
+     *                 stored.  May be nullptr if persistent storage is
+     *                 not available.
      */
     ConfigurationObject(GDBusConnection *dbuscon,
                         std::function<void()> remove_callback,
+                        std::function<void()> update_callback,
                         std::string objpath,
-                        uid_t creator, GVariant *params)
+                        uid_t creator, GVariant *params,
+                        ConfigProfileStore::Ptr store)
         : DBusObject(objpath),
           ConfigManagerSignals(dbuscon, objpath),
           DBusCredentials(dbuscon, creator),
           remove_callback(remove_callback),
+          update_callback(update_callback),
+          store(store),
           name(""),
           import_tstamp(std::time(nullptr)),
           last_use_tstamp(0),
@@ -304,15 +320,24 @@ public:
           readonly(false),
           single_use(false),
           persistent(false),
+          locked_down(false),
           persist_tun(false),
-          alias(nullptr)
+          alias(nullptr),
+          options_evicted(false),
+          options_access(std::time(nullptr)),
+          options_version(0),
+          persist_timer(0)
     {
         gchar *cfgstr;
         gchar *cfgname_c;
+        gboolean single_use_b = FALSE;
+        gboolean persistent_b = FALSE;
         g_variant_get (params, "(ssbb)",
                        &cfgname_c, &cfgstr,
-                       &single_use, &persistent);
+                       &single_use_b, &persistent_b);
         name = std::string(cfgname_c);
+        single_use = single_use_b;
+        persistent = persistent_b;
 
         // Parse the options from the imported configuration
         OptionList::Limits limits("profile is too large",
@@ -327,57 +352,228 @@ public:
         //         contains files
         valid = true;
 
-        std::string introsp_xml ="<node name='" + objpath + "'>"
-            "    <interface name='net.openvpn.v3.configuration'>"
-            "        <method name='Fetch'>"
-            "            <arg direction='out' type='s' name='config'/>"
-            "        </method>"
-            "        <method name='FetchJSON'>"
-            "            <arg direction='out' type='s' name='config_json'/>"
-            "        </method>"
-            "        <method name='SetOption'>"
-            "            <arg direction='in' type='s' name='option'/>"
-            "            <arg direction='in' type='s' name='value'/>"
-            "        </method>"
-            "        <method name='AccessGrant'>"
-            "            <arg direction='in' type='u' name='uid'/>"
-            "        </method>"
-            "        <method name='AccessRevoke'>"
-            "            <arg direction='in' type='u' name='uid'/>"
-            "        </method>"
-            "        <method name='Seal'/>"
-            "        <method name='Remove'/>"
-            "        <property type='u' name='owner' access='read'/>"
-            "        <property type='au' name='acl' access='read'/>"
-            "        <property type='s' name='name' access='readwrite'/>"
-            "        <property type='t' name='import_timestamp' access='read' />"
-            "        <property type='t' name='last_used_timestamp' access='read' />"
-            "        <property type='u' name='used_count' access='read' />"
-            "        <property type='b' name='valid' access='read'/>"
-            "        <property type='b' name='readonly' access='read'/>"
-            "        <property type='b' name='single_use' access='read'/>"
-            "        <property type='b' name='persistent' access='read'/>"
-            "        <property type='b' name='locked_down' access='readwrite'/>"
-            "        <property type='b' name='public_access' access='readwrite'/>"
-            "        <property type='b' name='persist_tun' access='readwrite' />"
-            "        <property type='s' name='alias' access='readwrite'/>"
-            "    </interface>"
-            "</node>";
-        ParseIntrospectionXML(introsp_xml);
+        prepare_object();
 
         g_free(cfgname_c);
         g_free(cfgstr);
+
+        // A newly imported profile is stored right away
+        persist_now();
+    }
+
+
+    /**
+     *  Constructor restoring a ConfigurationObject from the persistent
+     *  profile store.  The configuration profile is not parsed again, the
+     *  already parsed options are restored directly.
+     *
+     * @param dbuscon  D-Bus connection this object is tied to
+     * @param remove_callback  Callback function which must be called when
+     *                 destroying this configuration object.
+     * @param update_callback  Callback function which is called when the
+     *                 name or alias of this configuration object changes.
+     * @param objpath  D-Bus object path of this object
+     * @param store    ConfigProfileStore the profile was loaded from
+     * @param data     GVariant object with the stored profile, in the
+     *                 StoreFormat layout
+     */
+    ConfigurationObject(GDBusConnection *dbuscon,
+                        std::function<void()> remove_callback,
+                        std::function<void()> update_callback,
+                        std::string objpath,
+                        ConfigProfileStore::Ptr store,
+                        GVariant *data)
+        : DBusObject(objpath),
+          ConfigManagerSignals(dbuscon, objpath),
+          DBusCredentials(dbuscon, stored_owner(data)),
+          remove_callback(remove_callback),
+          update_callback(update_callback),
+          store(store),
+          name(""),
+          import_tstamp(0),
+          last_use_tstamp(0),
+          used_count(0),
+          valid(false),
+          readonly(false),
+          single_use(false),
+          persistent(true),
+          locked_down(false),
+          persist_tun(false),
+          alias(nullptr),
+          options_evicted(false),
+          options_access(std::time(nullptr)),
+          options_version(0),
+          persist_timer(0)
+    {
+        guint32 version = 0;
+        gchar *name_c = nullptr;
+        guint32 owner = 0;
+        guint64 import_t = 0;
+        guint64 last_use_t = 0;
+        guint32 used = 0;
+        gboolean valid_b = FALSE;
+        gboolean readonly_b = FALSE;
+        gboolean single_use_b = FALSE;
+        gboolean locked_down_b = FALSE;
+        gboolean public_access_b = FALSE;
+        gboolean persist_tun_b = FALSE;
+        gchar *alias_c = nullptr;
+        GVariantIter *acl_it = nullptr;
+        GVariant *opts = nullptr;
+        g_variant_get(data, "(usuttubbbbbbsau@aas)",
+                      &version, &name_c, &owner, &import_t, &last_use_t,
+                      &used, &valid_b, &readonly_b, &single_use_b,
+                      &locked_down_b, &public_access_b, &persist_tun_b,
+                      &alias_c, &acl_it, &opts);
+
+        name = std::string(name_c);
+        import_tstamp = (std::time_t) import_t;
+        last_use_tstamp = (std::time_t) last_use_t;
+        used_count = used;
+        valid = valid_b;
+        readonly = readonly_b;
+        single_use = single_use_b;
+        locked_down = locked_down_b;
+        persist_tun = persist_tun_b;
+        stored_alias = std::string(alias_c);
+        SetPublicAccess(public_access_b);
+        g_free(name_c);
+        g_free(alias_c);
+
+        guint32 uid = 0;
+        while (g_variant_iter_next(acl_it, "u", &uid))
+        {
+            GrantAccess(uid);
+        }
+        g_variant_iter_free(acl_it);
+
+        if (StoreFormatVersion != version || 0 == g_variant_n_children(opts))
+        {
+            g_variant_unref(opts);
+            THROW_DBUSEXCEPTION("ConfigurationObject",
+                                "Unsupported or empty stored profile");
+        }
+
+        // The options are only parsed on first use.  Until then they
+        // are kept in the compact form, sharing identical strings with
+        // the other profiles.
+        options_compact = CompactOptionList(opts);
+        options_evicted = true;
+
+        // The compact form is a copy; this releases the mapped profile
+        g_variant_unref(opts);
+        prepare_object();
     }
 
 
+    /**
+     *  GVariant layout of a profile in the ConfigProfileStore
+     *
+     *  (version, name, owner, import_timestamp, last_used_timestamp,
+     *   used_count, valid, readonly, single_use, locked_down,
+     *   public_access, persist_tun, alias, acl, options)
+     */
+    static constexpr const char *StoreFormat = "(usuttubbbbbbsauaas)";
+    static const guint32 StoreFormatVersion = 1;
+
+
     ~ConfigurationObject()
     {
+        FlushPersist();
+        clear_export_cache();
         remove_callback();
         LogVerb2("Configuration removed");
         IdleCheck_RefDec();
     };
 
 
+    /**
+     *  Retrieve the name of the configuration profile
+     *
+     * @return  Returns a std::string with the profile name
+     */
+    std::string GetName() const
+    {
+        return name;
+    }
+
+
+    /**
+     *  Retrieve the alias name of the configuration profile
+     *
+     * @return  Returns a std::string with the alias name, which is empty
+     *          if no alias is set
+     */
+    std::string GetAliasName() const
+    {
+        return (alias ? std::string(alias->GetAlias()) : "");
+    }
+
+
+    /**
+     *  Releases the parsed configuration options if they have not been
+     *  used for a while.  The options are kept in a CompactOptionList,
+     *  and are restored again on next use.
+     *
+     * @param max_idle  Number of seconds the options must have been
+     *                  unused before they are released
+     */
+    void EvictOptions(const std::time_t max_idle)
+    {
+        if (options_evicted
+            || (std::time(nullptr) - options_access) < max_idle)
+        {
+            return;
+        }
+        options_compact = CompactOptionList(options);
+        options_evicted = true;
+        options = OptionListJSON();
+        clear_export_cache();
+    }
+
+
+    /**
+     *  Writes any pending changes of this profile to the persistent
+     *  profile store right away
+     */
+    void FlushPersist()
+    {
+        if (persist_timer > 0)
+        {
+            persist_now();
+        }
+    }
+
+
+    /**
+     *  Registers the alias of a profile restored from the persistent
+     *  profile store.  This must be called after the object itself has
+     *  been registered on the D-Bus.
+     *
+     * @param conn  D-Bus connection to register the alias on
+     */
+    void RestoreAlias(GDBusConnection *conn)
+    {
+        if (stored_alias.empty())
+        {
+            return;
+        }
+        try
+        {
+            alias = new ConfigurationAlias(conn, stored_alias, GetObjectPath());
+            alias->RegisterObject(conn);
+        }
+        catch (DBusException& excp)
+        {
+            delete alias;
+            alias = nullptr;
+            LogWarn("Could not restore alias '" + stored_alias + "': "
+                    + std::string(excp.what()));
+        }
+        stored_alias.clear();
+    }
+
+
     /**
      *  Callback method which is called each time a D-Bus method call occurs
      *  on this ConfigurationObject.
@@ -417,8 +613,7 @@ public:
                     CheckOwnerAccess(sender, true);
                 }
                 g_dbus_method_invocation_return_value(invoc,
-                                                      g_variant_new("(s)",
-                                                                    options.string_export().c_str()));
+                                                      get_export(export_config));
 
                 // If the fetching user is root, we consider this
                 // configuration to be "used"
@@ -429,12 +624,14 @@ public:
                     if (single_use)
                     {
                         LogVerb2("Single-use configuration fetched");
+                        unpersist();
                         RemoveObject(conn);
                         delete this;
                         return;
                     }
                     used_count++;
                     last_use_tstamp = std::time(nullptr);
+                    persist();
                 }
                 return;
             }
@@ -459,8 +656,7 @@ public:
                     CheckOwnerAccess(sender);
                 }
                 g_dbus_method_invocation_return_value(invoc,
-                                                      g_variant_new("(s)",
-                                                                    options.json_export().c_str()));
+                                                      get_export(export_json));
 
                 // Do not remove single-use object with this method.
                 // FetchJSON is only used by front-ends, never backends.  So
@@ -476,7 +672,9 @@ public:
                 excp.SetDBusError(invoc);
             }
         }
-        else if ("SetOption" == method_name)
+        else if ("SetOption" == method_name
+                 || "UnsetOption" == method_name
+                 || "SetOptions" == method_name)
         {
             if (readonly)
             {
@@ -488,8 +686,85 @@ public:
             try
             {
                 CheckOwnerAccess(sender);
-                // TODO: Implement SetOption
+
+                // Collect all the changes first, so nothing is changed
+                // if any of the options are invalid
+                std::vector<std::pair<std::string, std::string>> changes;
+                bool unset = false;
+                if ("SetOption" == method_name)
+                {
+                    gchar *opt_c = nullptr;
+                    gchar *val_c = nullptr;
+                    g_variant_get(params, "(ss)", &opt_c, &val_c);
+                    changes.push_back(std::make_pair(std::string(opt_c),
+                                                     std::string(val_c)));
+                    g_free(opt_c);
+                    g_free(val_c);
+                }
+                else if ("UnsetOption" == method_name)
+                {
+                    gchar *opt_c = nullptr;
+                    g_variant_get(params, "(s)", &opt_c);
+                    changes.push_back(std::make_pair(std::string(opt_c), ""));
+                    g_free(opt_c);
+                    unset = true;
+                }
+                else
+                {
+                    GVariantIter *opts_it = nullptr;
+                    g_variant_get(params, "(a{ss})", &opts_it);
+                    gchar *opt_c = nullptr;
+                    gchar *val_c = nullptr;
+                    while (g_variant_iter_next(opts_it, "{ss}", &opt_c, &val_c))
+                    {
+                        changes.push_back(std::make_pair(std::string(opt_c),
+                                                         std::string(val_c)));
+                        g_free(opt_c);
+                        g_free(val_c);
+                    }
+                    g_variant_iter_free(opts_it);
+                }
+
+                std::vector<Option> new_opts;
+                for (const auto& c : changes)
+                {
+                    if (!valid_option_name(c.first))
+                    {
+                        g_dbus_method_invocation_return_dbus_error(invoc,
+                                                                   "net.openvpn.v3.error.InvalidData",
+                                                                   ("Invalid option name: '" + c.first + "'").c_str());
+                        return;
+                    }
+                    if (!unset)
+                    {
+                        new_opts.push_back(build_option(c.first, c.second));
+                    }
+                }
+
+                OptionListJSON& opts = get_options();
+                bool modified = false;
+                for (size_t i = 0; i < changes.size(); i++)
+                {
+                    if (unset)
+                    {
+                        modified |= replace_option(opts, changes[i].first, nullptr);
+                    }
+                    else
+                    {
+                        replace_option(opts, changes[i].first, &new_opts[i]);
+                        modified = true;
+                    }
+                }
+                if (modified)
+                {
+                    opts.update_map();
+                    options_changed(conn);
+                }
                 g_dbus_method_invocation_return_value(invoc, NULL);
+
+                LogVerb2(method_name + ": " + std::to_string(changes.size())
+                         + " option(s) changed by UID "
+                         + std::to_string(GetUID(sender)));
                 return;
             }
             catch (DBusCredentialsException& excp)
@@ -497,6 +772,18 @@ public:
                 LogWarn(excp.err());
                 excp.SetDBusError(invoc);
             }
+            catch (DBusException& excp)
+            {
+                g_dbus_method_invocation_return_dbus_error(invoc,
+                                                           "net.openvpn.v3.error.InvalidData",
+                                                           excp.getRawError().c_str());
+            }
+            catch (std::exception& excp)
+            {
+                g_dbus_method_invocation_return_dbus_error(invoc,
+                                                           "net.openvpn.v3.error.InvalidData",
+                                                           excp.what());
+            }
         }
         else if ("AccessGrant" == method_name)
         {
@@ -515,6 +802,7 @@ public:
                 uid_t uid = -1;
                 g_variant_get(params, "(u)", &uid);
                 GrantAccess(uid);
+                persist();
                 g_dbus_method_invocation_return_value(invoc, NULL);
 
                 LogVerb1("Access granted to UID " + std::to_string(uid)
@@ -544,6 +832,7 @@ public:
                 uid_t uid = -1;
                 g_variant_get(params, "(u)", &uid);
                 RevokeAccess(uid);
+                persist();
                 g_dbus_method_invocation_return_value(invoc, NULL);
 
                 LogVerb1("Access revoked for UID " + std::to_string(uid)
@@ -564,6 +853,7 @@ public:
 
                 if (valid) {
                     readonly = true;
+                    persist();
                     g_dbus_method_invocation_return_value(invoc, NULL);
                 }
                 else
@@ -585,6 +875,7 @@ public:
             try
             {
                 CheckOwnerAccess(sender);
+                unpersist();
                 RemoveObject(conn);
                 g_dbus_method_invocation_return_value(invoc, NULL);
                 delete this;
@@ -683,6 +974,10 @@ public:
             {
                 ret = g_variant_new_string(alias ? alias->GetAlias() : "");
             }
+            else if ("options_version" == property_name)
+            {
+                ret = g_variant_new_uint32(options_version);
+            }
             else if ("locked_down" == property_name)
             {
                 ret = g_variant_new_boolean (locked_down);
@@ -777,6 +1072,7 @@ public:
                 {
                     delete alias;
                     alias = nullptr;
+                    update_callback();
                     throw DBusPropertyException(G_IO_ERROR, G_IO_ERROR_EXISTS,
                                                 obj_path, intf_name, property_name,
                                                 err.getRawError().c_str());
@@ -817,6 +1113,11 @@ public:
                                             "Denied");
             };
 
+            if ("alias" == property_name || "name" == property_name)
+            {
+                update_callback();
+            }
+            persist();
             return ret;
         }
         catch (DBusCredentialsException& excp)
@@ -831,6 +1132,9 @@ public:
 
 private:
     std::function<void()> remove_callback;
+    std::function<void()> update_callback;
+    ConfigProfileStore::Ptr store;
+    std::string stored_alias;
     std::string name;
     std::time_t import_tstamp;
     std::time_t last_use_tstamp;
@@ -843,77 +1147,578 @@ private:
     bool persist_tun;
     ConfigurationAlias *alias;
     OptionListJSON options;
-};
-
+    CompactOptionList options_compact;
+    bool options_evicted;
+    std::time_t options_access;
+    unsigned int options_version;
+    guint persist_timer;
 
-/**
- *  The ConfigManagerObject is the main object for the Configuration Manager
- *  D-Bus service.  Whenever any user (D-Bus clients) accesses the main
- *  object path, this object is invoked.
- *
- *  This object basically handles the Import method, which takes a
- *  configuration profile as input and creates a ConfigurationObject.  There
- *  will exist a ConfigurationObject for each imported profile, having its
- *  own unique D-Bus object path.  Whenever a user (D-Bus client) accesses
- *  an object, the ConfigurationObject is invoked directly by the D-Bus
- *  implementation.
- */
-class ConfigManagerObject : public DBusObject,
-                            public ConfigManagerSignals,
-                            public RC<thread_safe_refcount>
-{
-public:
-    typedef  RCPtr<ConfigManagerObject> Ptr;
+    /**
+     *  Seconds to collect changes before a persistent profile is
+     *  written to the profile store
+     */
+    static const guint persist_delay = 5;
 
     /**
-     *  Constructor initializing the ConfigManagerObject to be registered on
-     *  the D-Bus.
-     *
-     * @param dbuscon  D-Bus this object is tied to
-     * @param objpath  D-Bus object path to this object
+     *  A rendered Fetch or FetchJSON response, valid as long as the
+     *  options_version it was rendered from is current
      */
-    ConfigManagerObject(GDBusConnection *dbusc, const std::string objpath)
-        : DBusObject(objpath),
-          ConfigManagerSignals(dbusc, objpath),
-          dbuscon(dbusc),
-          creds(dbusc)
+    struct ExportCache
     {
-        std::stringstream introspection_xml;
-        introspection_xml << "<node name='" + objpath + "'>"
-                          << "    <interface name='" + OpenVPN3DBus_interf_configuration + "'>"
-                          << "        <method name='Import'>"
-                          << "          <arg type='s' name='name' direction='in'/>"
-                          << "          <arg type='s' name='config_str' direction='in'/>"
-                          << "          <arg type='b' name='single_use' direction='in'/>"
-                          << "          <arg type='b' name='persistent' direction='in'/>"
-                          << "          <arg type='o' name='config_path' direction='out'/>"
-                          << "        </method>"
-                          << "        <method name='FetchAvailableConfigs'>"
-                          << "          <arg type='ao' name='paths' direction='out'/>"
-                          << "        </method>"
-                          << GetLogIntrospection()
-                          << "    </interface>"
-                          << "</node>";
-        ParseIntrospectionXML(introspection_xml);
-
-        Debug("ConfigManagerObject registered on '" + OpenVPN3DBus_interf_configuration + "':" + objpath);
-    }
+        ExportCache(std::function<std::string(OptionListJSON&)> render)
+            : render(render),
+              value(nullptr),
+              version(0)
+        {
+        }
 
-    ~ConfigManagerObject()
-    {
-        LogInfo("Shutting down");
-        RemoveObject(dbuscon);
-    }
+        std::function<std::string(OptionListJSON&)> render;
+        GVariant *value;
+        unsigned int version;
+    };
+    ExportCache export_config{[](OptionListJSON& o) { return o.string_export(); }};
+    ExportCache export_json{[](OptionListJSON& o) { return o.json_export(); }};
 
 
     /**
-     * Enables logging to file in addition to the D-Bus Log signal events
-     *
-     * @param filename  String containing the name of the log file
+     *  Prepares the D-Bus object by parsing the introspection data
      */
-    void OpenLogFile(std::string filename)
+    void prepare_object()
     {
-        OpenLogFile(filename);
+        // The object path is not part of the introspection document,
+        // which allows all configuration objects to share the parsed
+        // document
+        std::string introsp_xml ="<node>"
+            "    <interface name='net.openvpn.v3.configuration'>"
+            "        <method name='Fetch'>"
+            "            <arg direction='out' type='s' name='config'/>"
+            "        </method>"
+            "        <method name='FetchJSON'>"
+            "            <arg direction='out' type='s' name='config_json'/>"
+            "        </method>"
+            "        <method name='SetOption'>"
+            "            <arg direction='in' type='s' name='option'/>"
+            "            <arg direction='in' type='s' name='value'/>"
+            "        </method>"
+            "        <method name='UnsetOption'>"
+            "            <arg direction='in' type='s' name='option'/>"
+            "        </method>"
+            "        <method name='SetOptions'>"
+            "            <arg direction='in' type='a{ss}' name='options'/>"
+            "        </method>"
+            "        <method name='AccessGrant'>"
+            "            <arg direction='in' type='u' name='uid'/>"
+            "        </method>"
+            "        <method name='AccessRevoke'>"
+            "            <arg direction='in' type='u' name='uid'/>"
+            "        </method>"
+            "        <method name='Seal'/>"
+            "        <method name='Remove'/>"
+            "        <property type='u' name='owner' access='read'/>"
+            "        <property type='au' name='acl' access='read'/>"
+            "        <property type='s' name='name' access='readwrite'/>"
+            "        <property type='t' name='import_timestamp' access='read' />"
+            "        <property type='t' name='last_used_timestamp' access='read' />"
+            "        <property type='u' name='used_count' access='read' />"
+            "        <property type='b' name='valid' access='read'/>"
+            "        <property type='b' name='readonly' access='read'/>"
+            "        <property type='b' name='single_use' access='read'/>"
+            "        <property type='b' name='persistent' access='read'/>"
+            "        <property type='b' name='locked_down' access='readwrite'/>"
+            "        <property type='b' name='public_access' access='readwrite'/>"
+            "        <property type='b' name='persist_tun' access='readwrite' />"
+            "        <property type='s' name='alias' access='readwrite'/>"
+            "        <property type='u' name='options_version' access='read'/>"
+            "    </interface>"
+            "</node>";
+        ParseIntrospectionXML(introsp_xml);
+    }
+
+
+    /**
+     *  Retrieve the owner of a stored profile.  This is needed before
+     *  the rest of the stored profile is restored.
+     *
+     * @param data  GVariant object with the stored profile
+     *
+     * @return  Returns the uid_t of the profile owner
+     */
+    static uid_t stored_owner(GVariant *data)
+    {
+        if (!g_variant_is_of_type(data, G_VARIANT_TYPE(StoreFormat)))
+        {
+            THROW_DBUSEXCEPTION("ConfigurationObject",
+                                "Invalid stored profile");
+        }
+        GVariant *v = g_variant_get_child_value(data, 2);
+        uid_t owner = g_variant_get_uint32(v);
+        g_variant_unref(v);
+        return owner;
+    }
+
+
+    /**
+     *  Retrieve the parsed configuration options.  If the options have
+     *  been evicted, they are restored from the stored form first.
+     *
+     * @return  Returns a reference to the OptionListJSON object
+     */
+    OptionListJSON& get_options()
+    {
+        options_access = std::time(nullptr);
+        if (options_evicted)
+        {
+            options_compact.Restore(options);
+            options_compact.clear();
+            options_evicted = false;
+        }
+        return options;
+    }
+
+
+    /**
+     *  Retrieve a rendered export of the configuration options, as
+     *  returned by Fetch and FetchJSON.  The export is only rendered again
+     *  if the options have been modified since it was last rendered.
+     *  Otherwise the same GVariant is returned to all callers.
+     *
+     * @param cache  ExportCache of the export to retrieve
+     *
+     * @return  Returns a GVariant (s) tuple.  This is not a floating
+     *          reference and is owned by the cache; the caller must take
+     *          its own reference if it is kept.
+     */
+    GVariant * get_export(ExportCache& cache)
+    {
+        if (nullptr == cache.value || cache.version != options_version)
+        {
+            if (cache.value)
+            {
+                g_variant_unref(cache.value);
+            }
+            std::string rendered = cache.render(get_options());
+            cache.value = g_variant_ref_sink(g_variant_new("(s)",
+                                                           rendered.c_str()));
+            cache.version = options_version;
+        }
+        options_access = std::time(nullptr);
+        return cache.value;
+    }
+
+
+    /**
+     *  Releases all rendered exports of the configuration options
+     */
+    void clear_export_cache()
+    {
+        for (ExportCache *cache : {&export_config, &export_json})
+        {
+            if (cache->value)
+            {
+                g_variant_unref(cache->value);
+                cache->value = nullptr;
+            }
+        }
+    }
+
+
+    /**
+     *  Checks if a string can be used as an option name in SetOption,
+     *  UnsetOption and SetOptions
+     */
+    static bool valid_option_name(const std::string& optname)
+    {
+        if (optname.empty() || optname.size() > ProfileParseLimits::MAX_DIRECTIVE_SIZE)
+        {
+            return false;
+        }
+        for (const auto c : optname)
+        {
+            if (!(isalnum((unsigned char) c) || '-' == c || '_' == c))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+
+    /**
+     *  Builds a parsed option from an option name and its value, as given
+     *  to SetOption or SetOptions.  A value spanning several lines is
+     *  kept as a single argument, like inline blocks such as <ca> in a
+     *  configuration file.  Otherwise the value is split into arguments
+     *  like a configuration file line.
+     *
+     * @param optname  std::string with the option name
+     * @param value    std::string with the option arguments, may be empty
+     *
+     * @return  Returns the parsed Option
+     */
+    static Option build_option(const std::string& optname,
+                               const std::string& value)
+    {
+        if (std::string::npos != value.find('\n'))
+        {
+            Option opt;
+            opt.push_back(optname);
+            opt.push_back(value);
+            return opt;
+        }
+
+        Option opt = OptionList::parse_option_from_line(optname + " " + value,
+                                                        nullptr);
+        if (0 == opt.size() || optname != opt.ref(0))
+        {
+            THROW_DBUSEXCEPTION("ConfigurationObject",
+                                "Invalid value for option '" + optname + "'");
+        }
+        return opt;
+    }
+
+
+    /**
+     *  Replaces all occurrences of an option in place.  The first
+     *  occurrence is replaced and the others are removed.  If the option
+     *  is not present, it is appended.  The caller must update the option
+     *  map via OptionList::update_map() when done.
+     *
+     * @param opts     OptionList to modify
+     * @param optname  std::string with the option name
+     * @param newopt   Option to replace with.  If nullptr, all occurrences
+     *                 are removed.
+     *
+     * @return  Returns true if the options were modified
+     */
+    static bool replace_option(OptionList& opts, const std::string& optname,
+                               const Option *newopt)
+    {
+        bool modified = false;
+        for (auto it = opts.begin(); it != opts.end(); )
+        {
+            if (0 == it->size() || optname != it->ref(0))
+            {
+                ++it;
+            }
+            else if (newopt && !modified)
+            {
+                *it = *newopt;
+                modified = true;
+                ++it;
+            }
+            else
+            {
+                it = opts.erase(it);
+                modified = true;
+            }
+        }
+        if (newopt && !modified)
+        {
+            opts.push_back(*newopt);
+            modified = true;
+        }
+        return modified;
+    }
+
+
+    /**
+     *  Called when the configuration options have been modified.  The
+     *  options_version is bumped, the profile is stored and a single
+     *  PropertiesChanged signal is issued for the whole change.
+     *
+     * @param conn  D-Bus connection to signal the change on
+     */
+    void options_changed(GDBusConnection *conn)
+    {
+        options_version++;
+        persist();
+        try
+        {
+            SignalPropertiesChanged(conn,
+                                    build_set_property_response("options_version",
+                                                                (guint) options_version));
+        }
+        catch (DBusException& excp)
+        {
+            LogError(excp.what());
+        }
+    }
+
+
+    /**
+     *  Serializes the configuration options into the form used by the
+     *  profile store.  No serialized copy is kept between writes, as that
+     *  would keep each profile in memory twice.  Evicted options are
+     *  serialized directly from their compact form.
+     *
+     * @return  Returns a floating GVariant reference of the type aas
+     */
+    GVariant * serialize_options()
+    {
+        if (options_evicted)
+        {
+            return options_compact.Serialize();
+        }
+
+        GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("aas"));
+        for (const auto& opt : options)
+        {
+            g_variant_builder_open(bld, G_VARIANT_TYPE("as"));
+            for (size_t i = 0; i < opt.size(); i++)
+            {
+                g_variant_builder_add(bld, "s", opt.ref(i).c_str());
+            }
+            g_variant_builder_close(bld);
+        }
+        GVariant *ret = g_variant_builder_end(bld);
+        g_variant_builder_unref(bld);
+        return ret;
+    }
+
+
+    /**
+     *  Schedules writing this configuration profile to the persistent
+     *  profile store, if this is a persistent profile.  Changes are
+     *  collected for persist_delay seconds, so a burst of changes, such
+     *  as a backend fetching the profile on each start, only results in
+     *  a single write.
+     */
+    void persist()
+    {
+        if (!persistent || !store || persist_timer > 0)
+        {
+            return;
+        }
+        persist_timer = g_timeout_add_seconds(persist_delay,
+                                              _cb_persist, this);
+    }
+
+
+    static gboolean _cb_persist(gpointer this_ptr)
+    {
+        ConfigurationObject *obj = (ConfigurationObject *) this_ptr;
+        obj->persist_timer = 0;
+        obj->persist_now();
+        return G_SOURCE_REMOVE;
+    }
+
+
+    /**
+     *  Writes this configuration profile to the persistent profile store,
+     *  if this is a persistent profile.  Any pending write scheduled by
+     *  persist() is done by this call.  Errors are only logged, the
+     *  profile remains available in memory.
+     */
+    void persist_now()
+    {
+        cancel_persist();
+        if (!persistent || !store)
+        {
+            return;
+        }
+
+        // Same layout as StoreFormat
+        GVariant *data = g_variant_new("(us@uttubbbb@bbs@au@aas)",
+                                       StoreFormatVersion,
+                                       name.c_str(),
+                                       GetOwner(),
+                                       (guint64) import_tstamp,
+                                       (guint64) last_use_tstamp,
+                                       (guint32) used_count,
+                                       valid, readonly, single_use,
+                                       locked_down,
+                                       GetPublicAccess(),
+                                       persist_tun,
+                                       (alias ? alias->GetAlias() : ""),
+                                       GetAccessList(),
+                                       serialize_options());
+
+        try
+        {
+            store->Save(GetObjectPath(), data);
+        }
+        catch (DBusException& excp)
+        {
+            LogError(excp.what());
+        }
+    }
+
+
+    /**
+     *  Cancels a pending write scheduled by persist()
+     */
+    void cancel_persist()
+    {
+        if (persist_timer > 0)
+        {
+            g_source_remove(persist_timer);
+            persist_timer = 0;
+        }
+    }
+
+
+    /**
+     *  Removes this configuration profile from the persistent profile
+     *  store
+     */
+    void unpersist()
+    {
+        cancel_persist();
+        if (!persistent || !store)
+        {
+            return;
+        }
+
+        try
+        {
+            store->Remove(GetObjectPath());
+        }
+        catch (DBusException& excp)
+        {
+            LogError(excp.what());
+        }
+    }
+};
+
+
+/**
+ *  The ConfigManagerObject is the main object for the Configuration Manager
+ *  D-Bus service.  Whenever any user (D-Bus clients) accesses the main
+ *  object path, this object is invoked.
+ *
+ *  This object basically handles the Import method, which takes a
+ *  configuration profile as input and creates a ConfigurationObject.  There
+ *  will exist a ConfigurationObject for each imported profile, having its
+ *  own unique D-Bus object path.  Whenever a user (D-Bus client) accesses
+ *  an object, the ConfigurationObject is invoked directly by the D-Bus
+ *  implementation.
+ */
+class ConfigManagerObject : public DBusObject,
+                            public DBusSubtree,
+                            public ConfigManagerSignals,
+                            public RC<thread_safe_refcount>
+{
+public:
+    typedef  RCPtr<ConfigManagerObject> Ptr;
+
+    /**
+     *  Constructor initializing the ConfigManagerObject to be registered on
+     *  the D-Bus.
+     *
+     * @param dbuscon  D-Bus this object is tied to
+     * @param objpath  D-Bus object path to this object
+     * @param store    ConfigProfileStore for persistent profiles.  May be
+     *                 nullptr if persistent storage is not available.
+     */
+    ConfigManagerObject(GDBusConnection *dbusc, const std::string objpath,
+                        ConfigProfileStore::Ptr store)
+        : DBusObject(objpath),
+          DBusSubtree(objpath),
+          ConfigManagerSignals(dbusc, objpath),
+          dbuscon(dbusc),
+          creds(dbusc),
+          store(store),
+          evict_timer(0)
+    {
+        std::stringstream introspection_xml;
+        introspection_xml << "<node name='" + objpath + "'>"
+                          << "    <interface name='" + OpenVPN3DBus_interf_configuration + "'>"
+                          << "        <method name='Import'>"
+                          << "          <arg type='s' name='name' direction='in'/>"
+                          << "          <arg type='s' name='config_str' direction='in'/>"
+                          << "          <arg type='b' name='single_use' direction='in'/>"
+                          << "          <arg type='b' name='persistent' direction='in'/>"
+                          << "          <arg type='o' name='config_path' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='FetchAvailableConfigs'>"
+                          << "          <arg type='ao' name='paths' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='FetchAvailableConfigsDetailed'>"
+                          << "          <arg type='u' name='offset' direction='in'/>"
+                          << "          <arg type='u' name='limit' direction='in'/>"
+                          << "          <arg type='as' name='fields' direction='in'/>"
+                          << "          <arg type='a(oa{sv})' name='configs' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='LookupConfigName'>"
+                          << "          <arg type='s' name='config_name' direction='in'/>"
+                          << "          <arg type='ao' name='config_paths' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='LookupConfigByOwner'>"
+                          << "          <arg type='u' name='owner' direction='in'/>"
+                          << "          <arg type='ao' name='config_paths' direction='out'/>"
+                          << "        </method>"
+                          << GetLogIntrospection()
+                          << "    </interface>"
+                          << "</node>";
+        ParseIntrospectionXML(introspection_xml);
+
+        Debug("ConfigManagerObject registered on '" + OpenVPN3DBus_interf_configuration + "':" + objpath);
+
+        evict_timer = g_timeout_add_seconds(options_evict_interval,
+                                            _cb_evict_options, this);
+    }
+
+    ~ConfigManagerObject()
+    {
+        LogInfo("Shutting down");
+        g_source_remove(evict_timer);
+        RemoveSubtree(dbuscon);
+        RemoveObject(dbuscon);
+    }
+
+
+    /**
+     * Enables logging to file in addition to the D-Bus Log signal events
+     *
+     * @param filename  String containing the name of the log file
+     */
+    void OpenLogFile(std::string filename)
+    {
+        OpenLogFile(filename);
+    }
+
+
+    /**
+     *  Loads all persistent configuration profiles from the profile store
+     *  and registers them on the D-Bus.  Profiles which cannot be loaded
+     *  are logged and skipped.
+     */
+    void LoadProfiles()
+    {
+        if (!store)
+        {
+            return;
+        }
+
+        unsigned int count = 0;
+        auto errors = store->Load(G_VARIANT_TYPE(ConfigurationObject::StoreFormat),
+                                  [this, &count](const std::string& cfgpath,
+                                                  GVariant *data)
+                                  {
+                                      restore_config_object(cfgpath, data);
+                                      count++;
+                                  });
+        for (const auto& e : errors)
+        {
+            LogError(e);
+        }
+        LogVerb1("Loaded " + std::to_string(count)
+                 + " persistent configuration profiles from "
+                 + store->GetStateDir());
+    }
+
+
+    /**
+     *  Writes all pending changes of persistent configuration profiles
+     *  to the profile store.  This must be called before the service
+     *  stops.
+     */
+    void FlushProfiles()
+    {
+        for (auto& item : config_objects)
+        {
+            item.second->FlushPersist();
+        }
     }
 
 
@@ -950,13 +1755,19 @@ public:
                                                    {
                                                        self->remove_config_object(cfgpath);
                                                    },
+                                                   [self=Ptr(this), cfgpath]()
+                                                   {
+                                                       self->index_config_object(cfgpath);
+                                                   },
                                                    cfgpath,
                                                    creds.GetUID(sender),
-                                                   params);
+                                                   params,
+                                                   store);
             IdleCheck_RefInc();
             cfgobj->IdleCheck_Register(IdleCheck_Get());
-            cfgobj->RegisterObject(conn);
+            cfgobj->RegisterSubtreeObject();
             config_objects[cfgpath] = cfgobj;
+            index_config_object(cfgpath);
 
             Debug(std::string("ConfigurationObject registered on '")
                          + intf_name + "': " + cfgpath
@@ -994,6 +1805,95 @@ public:
             g_variant_builder_unref(bld);
             g_variant_builder_unref(ret);
         }
+        else if ("FetchAvailableConfigsDetailed" == method_name)
+        {
+            // Retrieve paging information and the properties to include
+            guint32 offset = 0;
+            guint32 limit = 0;
+            GVariantIter *fields_it = NULL;
+            g_variant_get(params, "(uuas)", &offset, &limit, &fields_it);
+
+            std::vector<std::string> fields;
+            gchar *field = NULL;
+            while (g_variant_iter_next(fields_it, "s", &field))
+            {
+                fields.push_back(std::string(field));
+                g_free(field);
+            }
+            g_variant_iter_free(fields_it);
+
+            // Build up an array of object paths and the property values of
+            // each object the caller is granted access to.  The offset and
+            // limit applies to the list of accessible objects only.
+            GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("a(oa{sv})"));
+            guint32 idx = 0;
+            guint32 count = 0;
+            for (auto& item : config_objects)
+            {
+                if (limit > 0 && count >= limit)
+                {
+                    break;
+                }
+
+                try {
+                    item.second->CheckACL(sender);
+                }
+                catch (DBusCredentialsException& excp)
+                {
+                    // Ignore credentials exceptions.  It means the
+                    // caller does not have access this object
+                    continue;
+                }
+
+                if (idx++ < offset)
+                {
+                    continue;
+                }
+                g_variant_builder_add(bld, "(o@a{sv})", item.first.c_str(),
+                                      item.second->GetPropertyDict(conn, sender,
+                                                                   fields));
+                count++;
+            }
+            g_dbus_method_invocation_return_value(invoc,
+                                                  g_variant_new("(a(oa{sv}))", bld));
+            g_variant_builder_unref(bld);
+        }
+        else if ("LookupConfigName" == method_name)
+        {
+            // Both profile names and alias names are matched
+            gchar *cfgname_c = nullptr;
+            g_variant_get(params, "(s)", &cfgname_c);
+            std::string cfgname(cfgname_c);
+            g_free(cfgname_c);
+
+            std::set<std::string> paths;
+            auto n = name_index.find(cfgname);
+            if (name_index.end() != n)
+            {
+                paths = n->second;
+            }
+            auto a = alias_index.find(cfgname);
+            if (alias_index.end() != a)
+            {
+                paths.insert(a->second);
+            }
+            g_dbus_method_invocation_return_value(invoc,
+                                                  build_lookup_response(sender, paths));
+        }
+        else if ("LookupConfigByOwner" == method_name)
+        {
+            guint32 owner = 0;
+            g_variant_get(params, "(u)", &owner);
+
+            std::set<std::string> paths;
+            auto o = owner_index.find((uid_t) owner);
+            if (owner_index.end() != o)
+            {
+                paths = o->second;
+            }
+            g_dbus_method_invocation_return_value(invoc,
+                                                  build_lookup_response(sender, paths));
+        }
     };
 
 
@@ -1065,7 +1965,230 @@ public:
 private:
     GDBusConnection *dbuscon;
     DBusConnectionCreds creds;
+    ConfigProfileStore::Ptr store;
     std::map<std::string, ConfigurationObject *> config_objects;
+    guint evict_timer;
+
+    /**
+     *  Index entries of a configuration object, used to find the
+     *  entries to remove when the object changes or is removed
+     */
+    struct IndexEntry
+    {
+        std::string name;
+        std::string alias;
+        uid_t owner;
+    };
+    std::unordered_map<std::string, IndexEntry> index_entries;
+    std::unordered_map<std::string, std::set<std::string>> name_index;
+    std::unordered_map<std::string, std::string> alias_index;
+    std::unordered_map<uid_t, std::set<std::string>> owner_index;
+
+    /**
+     *  Parsed configuration options unused for this many seconds are
+     *  released, checked every options_evict_interval seconds
+     */
+    static const std::time_t options_idle_limit = 300;
+    static const guint options_evict_interval = 60;
+
+
+    /**
+     *  Lists the node names of all the configuration objects served by
+     *  the subtree
+     *
+     * @param sender  D-Bus bus name of the caller
+     *
+     * @return  Returns a std::vector<std::string> of node names
+     */
+    std::vector<std::string> callback_subtree_enumerate(const std::string sender)
+    {
+        std::vector<std::string> nodes;
+        std::string prefix = GetObjectPath() + "/";
+        for (const auto& item : config_objects)
+        {
+            nodes.push_back(item.first.substr(prefix.size()));
+        }
+        return nodes;
+    }
+
+
+    /**
+     *  Looks up the configuration object of a subtree node
+     *
+     * @param node  std::string with the node name
+     *
+     * @return  Returns a pointer to the ConfigurationObject, or nullptr
+     *          if not found
+     */
+    DBusObject * callback_subtree_lookup(const std::string node)
+    {
+        auto it = config_objects.find(GetObjectPath() + "/" + node);
+        return (config_objects.end() != it ? it->second : nullptr);
+    }
+
+
+    /**
+     *  Timer callback releasing the parsed configuration options of
+     *  configuration objects not used recently
+     */
+    static gboolean _cb_evict_options(gpointer this_ptr)
+    {
+        ConfigManagerObject *self = (ConfigManagerObject *) this_ptr;
+        for (auto& item : self->config_objects)
+        {
+            item.second->EvictOptions(options_idle_limit);
+        }
+        return G_SOURCE_CONTINUE;
+    }
+
+
+    /**
+     *  Creates a ConfigurationObject from a stored profile and registers
+     *  it on the D-Bus
+     *
+     * @param cfgpath  std::string with the object path of the profile
+     * @param data     GVariant object with the stored profile
+     */
+    void restore_config_object(const std::string& cfgpath, GVariant *data)
+    {
+        if (config_objects.find(cfgpath) != config_objects.end())
+        {
+            THROW_DBUSEXCEPTION("ConfigManagerObject",
+                                "Configuration " + cfgpath + " already exists");
+        }
+
+        auto *cfgobj = new ConfigurationObject(dbuscon,
+                                               [self=Ptr(this), cfgpath]()
+                                               {
+                                                   self->remove_config_object(cfgpath);
+                                               },
+                                               [self=Ptr(this), cfgpath]()
+                                               {
+                                                   self->index_config_object(cfgpath);
+                                               },
+                                               cfgpath,
+                                               store,
+                                               data);
+        IdleCheck_RefInc();
+        cfgobj->IdleCheck_Register(IdleCheck_Get());
+        cfgobj->RegisterSubtreeObject();
+        cfgobj->RestoreAlias(dbuscon);
+        config_objects[cfgpath] = cfgobj;
+        index_config_object(cfgpath);
+    }
+
+
+    /**
+     *  Updates the name, alias and owner indexes of a configuration object.
+     *  Any previous index entries of the object are replaced.
+     *
+     * @param cfgpath  std::string containing the object path to the object
+     *                 to index
+     */
+    void index_config_object(const std::string cfgpath)
+    {
+        unindex_config_object(cfgpath);
+
+        auto it = config_objects.find(cfgpath);
+        if (config_objects.end() == it)
+        {
+            return;
+        }
+
+        IndexEntry entry;
+        entry.name = it->second->GetName();
+        entry.alias = it->second->GetAliasName();
+        entry.owner = it->second->GetOwnerUID();
+
+        name_index[entry.name].insert(cfgpath);
+        if (!entry.alias.empty())
+        {
+            alias_index[entry.alias] = cfgpath;
+        }
+        owner_index[entry.owner].insert(cfgpath);
+        index_entries[cfgpath] = entry;
+    }
+
+
+    /**
+     *  Removes a configuration object from the name, alias and owner
+     *  indexes
+     *
+     * @param cfgpath  std::string containing the object path to the object
+     *                 to remove from the indexes
+     */
+    void unindex_config_object(const std::string& cfgpath)
+    {
+        auto it = index_entries.find(cfgpath);
+        if (index_entries.end() == it)
+        {
+            return;
+        }
+
+        const IndexEntry& entry = it->second;
+        auto n = name_index.find(entry.name);
+        if (name_index.end() != n)
+        {
+            n->second.erase(cfgpath);
+            if (n->second.empty())
+            {
+                name_index.erase(n);
+            }
+        }
+        auto a = alias_index.find(entry.alias);
+        if (alias_index.end() != a && cfgpath == a->second)
+        {
+            alias_index.erase(a);
+        }
+        auto o = owner_index.find(entry.owner);
+        if (owner_index.end() != o)
+        {
+            o->second.erase(cfgpath);
+            if (o->second.empty())
+            {
+                owner_index.erase(o);
+            }
+        }
+        index_entries.erase(it);
+    }
+
+
+    /**
+     *  Builds the method call response of the index lookup methods,
+     *  only including the configuration objects the caller is granted
+     *  access to
+     *
+     * @param sender  D-Bus bus name of the caller
+     * @param paths   std::set<std::string> of object paths found
+     *
+     * @return  Returns a GVariant tuple containing an array of object paths
+     */
+    GVariant * build_lookup_response(const std::string& sender,
+                                     const std::set<std::string>& paths)
+    {
+        GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("ao"));
+        for (const auto& cfgpath : paths)
+        {
+            auto it = config_objects.find(cfgpath);
+            if (config_objects.end() == it)
+            {
+                continue;
+            }
+            try
+            {
+                it->second->CheckACL(sender);
+                g_variant_builder_add(bld, "o", cfgpath.c_str());
+            }
+            catch (DBusCredentialsException& excp)
+            {
+                // Ignore credentials exceptions.  It means the
+                // caller does not have access this configuration object
+            }
+        }
+        GVariant *ret = g_variant_new("(ao)", bld);
+        g_variant_builder_unref(bld);
+        return ret;
+    }
 
     /**
      * Callback function used by ConfigurationObject instances to remove
@@ -1077,6 +2200,7 @@ private:
      */
     void remove_config_object(const std::string cfgpath)
     {
+        unindex_config_object(cfgpath);
         config_objects.erase(cfgpath);
     }
 };
@@ -1106,12 +2230,17 @@ public:
                OpenVPN3DBus_interf_configuration),
           cfgmgr(nullptr),
           procsig(nullptr),
-          logfile("")
+          logfile(""),
+          statedir("")
     {
     };
 
     ~ConfigManagerDBus()
     {
+        if (cfgmgr)
+        {
+            cfgmgr->FlushProfiles();
+        }
         procsig->ProcessChange(StatusMinor::PROC_STOPPED);
         delete procsig;
     }
@@ -1129,18 +2258,46 @@ public:
     }
 
 
+    /**
+     *  Enables persistent storage of configuration profiles.  Profiles
+     *  imported with the persistent flag set are stored in this directory
+     *  and restored when the configuration manager starts.
+     *
+     * @param dir  Directory where persistent profiles are stored.
+     */
+    void SetStateDir(std::string dir)
+    {
+        statedir = dir;
+    }
+
+
     /**
      *  This callback is called when the service was successfully registered
      *  on the D-Bus.
      */
     void callback_bus_acquired()
     {
-        cfgmgr.reset(new ConfigManagerObject(GetConnection(), GetRootPath()));
+        ConfigProfileStore::Ptr store;
+        if (!statedir.empty())
+        {
+            try
+            {
+                store.reset(new ConfigProfileStore(statedir));
+            }
+            catch (DBusException& excp)
+            {
+                std::cerr << "** WARNING ** Persistent configuration profiles "
+                          << "are disabled: " << excp.what() << std::endl;
+            }
+        }
+        cfgmgr.reset(new ConfigManagerObject(GetConnection(), GetRootPath(),
+                                             store));
         if (!logfile.empty())
         {
             cfgmgr->OpenLogFile(logfile);
         }
         cfgmgr->RegisterObject(GetConnection());
+        cfgmgr->RegisterSubtree(GetConnection());
 
         procsig = new ProcessSignalProducer(GetConnection(),
                                             OpenVPN3DBus_interf_configuration,
@@ -1151,6 +2308,8 @@ public:
         {
             cfgmgr->IdleCheck_Register(idle_checker);
         }
+
+        cfgmgr->LoadProfiles();
     };
 
 
@@ -1186,6 +2345,7 @@ private:
     ConfigManagerObject::Ptr cfgmgr;
     ProcessSignalProducer * procsig;
     std::string logfile;
+    std::string statedir;
 };
 
 #endif // OPENVPN3_DBUS_CONFIGMGR_HPP
@@ -29,6 +29,18 @@ int main(int argc, char **argv)
 {
     std::cout << get_version(argv[0]) << std::endl;
 
+    // Persistent configuration profiles are stored in the state directory
+    std::string statedir(OPENVPN3_STATEDIR "/configs");
+    if (3 == argc && std::string("--state-dir") == argv[1])
+    {
+        statedir = std::string(argv[2]);
+    }
+    else if (1 != argc)
+    {
+        std::cerr << "Usage: " << argv[0] << " [--state-dir <directory>]" << std::endl;
+        return 1;
+    }
+
     // This program does not require root privileges,
     // so if used - drop those privileges
     drop_root();
@@ -41,10 +53,10 @@ int main(int argc, char **argv)
     // idling for 1 minute or more.  By idling, it means
     // no configuration files is stored in memory.
     IdleCheck::Ptr idle_exit = new IdleCheck(main_loop, std::chrono::minutes(3));
-    idle_exit->SetPollTime(std::chrono::seconds(30));
 
     ConfigManagerDBus cfgmgr(G_BUS_TYPE_SYSTEM);
     // cfgmgr.SetLogFile("/tmp/openvpn3-service-configmgr.log");
+    cfgmgr.SetStateDir(statedir);
     cfgmgr.EnableIdleCheck(idle_exit);
     cfgmgr.Setup();
 
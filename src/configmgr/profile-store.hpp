@@ -0,0 +1,250 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2018      OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2018      David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   profile-store.hpp
+ *
+ * @brief  On-disk storage of persistent VPN configuration profiles
+ */
+
+#ifndef OPENVPN3_DBUS_CONFIGMGR_PROFILESTORE_HPP
+#define OPENVPN3_DBUS_CONFIGMGR_PROFILESTORE_HPP
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <openvpn/common/rc.hpp>
+
+#include "dbus/constants.hpp"
+#include "dbus/exceptions.hpp"
+
+namespace openvpn
+{
+    /**
+     *  Stores each persistent configuration profile in its own file in
+     *  a state directory.  The file name is derived from the last element
+     *  of the D-Bus object path of the profile.
+     *
+     *  The file content is a serialized GVariant.  The store does not
+     *  interpret the content; the format is defined by the caller.  When
+     *  loading the profiles, the files are mapped into memory and the
+     *  GVariant data is used directly from the mapped file.  Files are
+     *  replaced atomically, so a crash never leaves a partially written
+     *  profile behind.
+     */
+    class ConfigProfileStore : public RC<thread_safe_refcount>
+    {
+    public:
+        typedef RCPtr<ConfigProfileStore> Ptr;
+
+        /**
+         *  Callback used by Load() for each stored profile
+         *
+         * @param objpath  std::string with the D-Bus object path of the
+         *                 profile
+         * @param data     GVariant object with the stored profile data.
+         *                 This is only valid during the callback.
+         */
+        typedef std::function<void(const std::string& objpath,
+                                   GVariant *data)> LoadCallback;
+
+
+        /**
+         *  Prepares the profile store.  The state directory is created if
+         *  it does not exist.
+         *
+         * @param statedir  std::string with the directory containing the
+         *                  stored profiles
+         */
+        ConfigProfileStore(const std::string statedir)
+            : statedir(statedir)
+        {
+            if (0 != g_mkdir_with_parents(statedir.c_str(), 0700))
+            {
+                THROW_DBUSEXCEPTION("ConfigProfileStore",
+                                    "Could not create the state directory "
+                                    + statedir + ": "
+                                    + std::string(strerror(errno)));
+            }
+        }
+
+
+        /**
+         *  Retrieve the state directory used by this store
+         *
+         * @return  Returns a std::string with the directory name
+         */
+        std::string GetStateDir() const
+        {
+            return statedir;
+        }
+
+
+        /**
+         *  Stores a profile.  Any previously stored data of the same
+         *  profile is replaced.
+         *
+         * @param objpath  std::string with the D-Bus object path of the
+         *                 profile
+         * @param data     GVariant object with the data to store.  A
+         *                 floating reference is consumed.
+         */
+        void Save(const std::string& objpath, GVariant *data)
+        {
+            g_variant_ref_sink(data);
+            GError *error = NULL;
+            g_file_set_contents(profile_filename(objpath).c_str(),
+                                (const gchar *) g_variant_get_data(data),
+                                g_variant_get_size(data),
+                                &error);
+            g_variant_unref(data);
+            if (error)
+            {
+                std::string errmsg(error->message);
+                g_error_free(error);
+                THROW_DBUSEXCEPTION("ConfigProfileStore",
+                                    "Could not store " + objpath + ": "
+                                    + errmsg);
+            }
+        }
+
+
+        /**
+         *  Removes a stored profile.  Removing a profile which is not
+         *  stored is not an error.
+         *
+         * @param objpath  std::string with the D-Bus object path of the
+         *                 profile
+         */
+        void Remove(const std::string& objpath)
+        {
+            if (0 != g_unlink(profile_filename(objpath).c_str())
+                && ENOENT != errno)
+            {
+                THROW_DBUSEXCEPTION("ConfigProfileStore",
+                                    "Could not remove " + objpath + ": "
+                                    + std::string(strerror(errno)));
+            }
+        }
+
+
+        /**
+         *  Loads all stored profiles.  Profiles which cannot be read, or
+         *  where the callback throws a DBusException, are skipped.
+         *
+         * @param type      GVariantType of the stored data
+         * @param callback  LoadCallback called for each stored profile
+         *
+         * @return  Returns a std::vector<std::string> with an error message
+         *          for each profile which could not be loaded.
+         */
+        std::vector<std::string> Load(const GVariantType *type,
+                                      LoadCallback callback)
+        {
+            std::vector<std::string> errors;
+
+            GError *error = NULL;
+            GDir *dir = g_dir_open(statedir.c_str(), 0, &error);
+            if (!dir)
+            {
+                errors.push_back("Could not read " + statedir + ": "
+                                 + std::string(error ? error->message : "(unknown)"));
+                if (error)
+                {
+                    g_error_free(error);
+                }
+                return errors;
+            }
+
+            const gchar *fname = NULL;
+            while (NULL != (fname = g_dir_read_name(dir)))
+            {
+                std::string f(fname);
+                if (f.size() <= suffix.size()
+                    || 0 != f.compare(f.size() - suffix.size(),
+                                      suffix.size(), suffix))
+                {
+                    // Ignore unrelated files, such as left-over
+                    // temporary files from an interrupted Save()
+                    continue;
+                }
+                std::string objpath = OpenVPN3DBus_rootp_configuration + "/"
+                                      + f.substr(0, f.size() - suffix.size());
+                if (!g_variant_is_object_path(objpath.c_str()))
+                {
+                    errors.push_back("Invalid profile file name: " + f);
+                    continue;
+                }
+
+                std::string path = statedir + "/" + f;
+                GMappedFile *mf = g_mapped_file_new(path.c_str(), FALSE, &error);
+                if (!mf)
+                {
+                    errors.push_back("Could not read " + path + ": "
+                                     + std::string(error ? error->message : "(unknown)"));
+                    if (error)
+                    {
+                        g_error_free(error);
+                        error = NULL;
+                    }
+                    continue;
+                }
+
+                // The GVariant keeps a reference to the mapped file
+                // through the GBytes object, for as long as it is used
+                GBytes *bytes = g_mapped_file_get_bytes(mf);
+                g_mapped_file_unref(mf);
+                GVariant *data = g_variant_ref_sink(g_variant_new_from_bytes(type, bytes, FALSE));
+                g_bytes_unref(bytes);
+                try
+                {
+                    callback(objpath, data);
+                }
+                catch (DBusException& excp)
+                {
+                    errors.push_back("Could not load " + path + ": "
+                                     + std::string(excp.what()));
+                }
+                g_variant_unref(data);
+            }
+            g_dir_close(dir);
+            return errors;
+        }
+
+
+    private:
+        const std::string suffix = ".profile";
+        std::string statedir;
+
+
+        std::string profile_filename(const std::string& objpath) const
+        {
+            return statedir + "/"
+                   + objpath.substr(objpath.rfind('/') + 1) + suffix;
+        }
+    };
+};
+
+#endif // OPENVPN3_DBUS_CONFIGMGR_PROFILESTORE_HPP
@@ -20,6 +20,7 @@
 #ifndef OPENVPN3_DBUS_PROXY_CONFIG_HPP
 #define OPENVPN3_DBUS_PROXY_CONFIG_HPP
 
+#include <map>
 #include <vector>
 
 #include "dbus/core.hpp"
@@ -114,6 +115,60 @@ public:
     }
 
 
+    /**
+     * Retrieves the configuration paths available to the calling user,
+     * together with the properties of each configuration profile, in a
+     * single D-Bus call.
+     *
+     * @param offset  Number of available configurations to skip
+     * @param limit   Maximum number of configurations to return,
+     *                0 returns all
+     * @param fields  Properties to retrieve. If empty, all properties
+     *                are retrieved.
+     *
+     * @return A DBusPropertySnapshotList of configuration paths and
+     *         their properties
+     */
+    DBusPropertySnapshotList FetchAvailableConfigsDetailed(guint32 offset = 0,
+                                                           guint32 limit = 0,
+                                                           std::vector<std::string> fields = {})
+    {
+        return FetchObjectsDetailed("FetchAvailableConfigsDetailed",
+                                    offset, limit, fields);
+    }
+
+
+    /**
+     * Looks up configuration profiles by name.  Both profile names and
+     * alias names are matched.  Only configurations available to the
+     * calling user are returned.
+     *
+     * @param cfgname  std::string with the configuration name to look up
+     *
+     * @return A std::vector<std::string> of configuration paths
+     */
+    std::vector<std::string> LookupConfigName(std::string cfgname)
+    {
+        return lookup_paths("LookupConfigName",
+                            g_variant_new("(s)", cfgname.c_str()));
+    }
+
+
+    /**
+     * Looks up configuration profiles owned by a specific user.  Only
+     * configurations available to the calling user are returned.
+     *
+     * @param owner  uid_t of the owner of the configuration profiles
+     *
+     * @return A std::vector<std::string> of configuration paths
+     */
+    std::vector<std::string> LookupConfigByOwner(uid_t owner)
+    {
+        return lookup_paths("LookupConfigByOwner",
+                            g_variant_new("(u)", (guint32) owner));
+    }
+
+
     std::string GetJSONConfig()
     {
         GVariant *res = Call("FetchJSON");
@@ -248,6 +303,82 @@ public:
     }
 
 
+    /**
+     * Modifies an option of this configuration profile.  All occurrences
+     * of the option are replaced.
+     *
+     * @param option  std::string with the option name
+     * @param value   std::string with the new option arguments
+     */
+    void SetOption(std::string option, std::string value)
+    {
+        GVariant *res = Call("SetOption",
+                             g_variant_new("(ss)", option.c_str(),
+                                           value.c_str()));
+        if (NULL == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3ConfigurationProxy",
+                                "Failed to set the option " + option);
+        }
+        g_variant_unref(res);
+    }
+
+
+    /**
+     * Removes all occurrences of an option from this configuration profile
+     *
+     * @param option  std::string with the option name
+     */
+    void UnsetOption(std::string option)
+    {
+        GVariant *res = Call("UnsetOption",
+                             g_variant_new("(s)", option.c_str()));
+        if (NULL == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3ConfigurationProxy",
+                                "Failed to unset the option " + option);
+        }
+        g_variant_unref(res);
+    }
+
+
+    /**
+     * Modifies several options of this configuration profile in a single
+     * operation.  If any of the options are invalid, nothing is modified.
+     *
+     * @param options  std::map of option names and their new arguments
+     */
+    void SetOptions(const std::map<std::string, std::string>& options)
+    {
+        GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("a{ss}"));
+        for (const auto& opt : options)
+        {
+            g_variant_builder_add(bld, "{ss}", opt.first.c_str(),
+                                  opt.second.c_str());
+        }
+        GVariant *res = Call("SetOptions", g_variant_new("(a{ss})", bld));
+        g_variant_builder_unref(bld);
+        if (NULL == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3ConfigurationProxy",
+                                "Failed to set the options");
+        }
+        g_variant_unref(res);
+    }
+
+
+    /**
+     * Retrieve the version of the configuration options, which is
+     * increased each time the options are modified
+     *
+     * @return Returns the options version as an unsigned int
+     */
+    unsigned int GetOptionsVersion()
+    {
+        return GetUIntProperty("options_version");
+    }
+
+
     void Seal()
     {
         GVariant *res = Call("Seal");
@@ -334,6 +465,31 @@ public:
 
 
 private:
+    std::vector<std::string> lookup_paths(std::string method, GVariant *params)
+    {
+        GVariant *res = Call(method, params);
+        if (NULL == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3ConfigurationProxy",
+                                "Failed to look up configurations");
+        }
+        GVariantIter *cfgpaths = NULL;
+        g_variant_get(res, "(ao)", &cfgpaths);
+
+        GVariant *path = NULL;
+        std::vector<std::string> ret;
+        while ((path = g_variant_iter_next_value(cfgpaths)))
+        {
+            gsize len;
+            ret.push_back(std::string(g_variant_get_string(path, &len)));
+            g_variant_unref(path);
+        }
+        g_variant_unref(res);
+        g_variant_iter_free(cfgpaths);
+        return ret;
+    }
+
+
     std::string get_object_path(const GBusType bus_type, std::string target)
     {
         if (target[0] != '/')
@@ -31,19 +31,204 @@
 
 #include <vector>
 #include <algorithm>
+#include <map>
+#include <mutex>
 #include <sys/types.h>
 
 #include "proxy.hpp"
+#include "signals.hpp"
 
 using namespace openvpn;
 
 namespace openvpn
 {
+    /**
+     *  Process wide cache of the credentials of D-Bus callers, keyed by
+     *  the D-Bus connection and the unique bus name of the caller.
+     *
+     *  Unique bus names are never reused by the D-Bus daemon and the
+     *  credentials of a connected D-Bus client never change.  Cached
+     *  entries are removed when the D-Bus daemon reports via the
+     *  NameOwnerChanged signal that the client disconnected.
+     */
+    class DBusConnectionCredsCache
+    {
+    public:
+        struct Credentials
+        {
+            uid_t uid;
+            pid_t pid;
+        };
+
+
+        /**
+         *  Retrieve the process wide credentials cache
+         */
+        static DBusConnectionCredsCache& Get()
+        {
+            static DBusConnectionCredsCache cache;
+            return cache;
+        }
+
+
+        /**
+         *  Look up the cached credentials of a bus name
+         *
+         * @param conn     GDBusConnection the bus name is valid on
+         * @param busname  std::string containing the bus name
+         * @param creds    Credentials struct where the result is stored
+         *
+         * @return  Returns true if the credentials were found in the cache
+         */
+        bool Lookup(GDBusConnection *conn, const std::string& busname,
+                    Credentials& creds)
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            auto it = entries.find(Key(conn, busname));
+            if (entries.end() == it)
+            {
+                return false;
+            }
+            creds = it->second;
+            return true;
+        }
+
+
+        /**
+         *  Start tracking disconnecting clients on a connection.  This
+         *  must be done before any credentials on this connection are
+         *  looked up, otherwise a client disconnecting during the lookup
+         *  could leave a stale cache entry behind.
+         *
+         * @param conn  GDBusConnection to track
+         */
+        void Track(GDBusConnection *conn)
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            if (routes.find(conn) != routes.end())
+            {
+                return;
+            }
+            routes[conn] = DBusSignalRouter::Get().AddRoute(conn,
+                                     "org.freedesktop.DBus",
+                                     "/org/freedesktop/DBus",
+                                     "org.freedesktop.DBus",
+                                     "NameOwnerChanged",
+                                     [this](GDBusConnection *c,
+                                            const std::string sender_name,
+                                            const std::string obj_path,
+                                            const std::string intf_name,
+                                            const std::string sig_name,
+                                            GVariant *params)
+                                     {
+                                         name_owner_changed(c, params);
+                                     });
+            disconnects[conn] = 0;
+        }
+
+
+        /**
+         *  Retrieve the number of disconnected clients seen so far on a
+         *  connection.  This must be retrieved before looking up the
+         *  credentials which are later passed to Store().
+         *
+         * @param conn  GDBusConnection to check
+         *
+         * @return  Returns the disconnect counter of the connection
+         */
+        unsigned long GetDisconnects(GDBusConnection *conn)
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            auto it = disconnects.find(conn);
+            return (disconnects.end() != it ? it->second : 0);
+        }
+
+
+        /**
+         *  Store the credentials of a bus name.  Only unique bus names are
+         *  cached, as the owner of a well-known bus name may change.
+         *
+         *  If a client has disconnected since the lookup started, it
+         *  might have been this bus name; the credentials are then not
+         *  cached.  The same goes for connections not being tracked.
+         *
+         * @param conn         GDBusConnection the bus name is valid on
+         * @param busname      std::string containing the bus name
+         * @param creds        Credentials struct to store
+         * @param disconnected Disconnect counter retrieved by
+         *                     GetDisconnects() before the lookup
+         */
+        void Store(GDBusConnection *conn, const std::string& busname,
+                   const Credentials& creds, unsigned long disconnected)
+        {
+            if (busname.empty() || ':' != busname[0])
+            {
+                return;
+            }
+
+            std::lock_guard<std::mutex> guard(mtx);
+            auto it = disconnects.find(conn);
+            if (disconnects.end() == it || disconnected != it->second)
+            {
+                return;
+            }
+            entries[Key(conn, busname)] = creds;
+        }
+
+
+        /**
+         *  Removes all cached credentials
+         */
+        void Flush()
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            entries.clear();
+        }
+
+
+    private:
+        typedef std::pair<GDBusConnection *, std::string> Key;
+
+        std::mutex mtx;
+        std::map<Key, Credentials> entries;
+        std::map<GDBusConnection *, guint> routes;
+        std::map<GDBusConnection *, unsigned long> disconnects;
+
+
+        DBusConnectionCredsCache()
+        {
+        }
+
+
+        void name_owner_changed(GDBusConnection *conn, GVariant *params)
+        {
+            gchar *name = nullptr;
+            gchar *old_owner = nullptr;
+            gchar *new_owner = nullptr;
+            g_variant_get(params, "(sss)", &name, &old_owner, &new_owner);
+
+            // A unique bus name without a new owner has disconnected
+            if (name && ':' == name[0] && new_owner && '\0' == new_owner[0])
+            {
+                std::lock_guard<std::mutex> guard(mtx);
+                entries.erase(Key(conn, std::string(name)));
+                ++disconnects[conn];
+            }
+            g_free(name);
+            g_free(old_owner);
+            g_free(new_owner);
+        }
+    };
+
+
     /**
      *   Queries the D-Bus daemon for the credentials of a specific D-Bus
      *   bus name.  Each D-Bus client performing an operation on a D-Bus
      *   object in a service connects with a unique bus name.  This is a
      *   safe method for retrieving information about who the caller is.
+     *
+     *   The results are cached in the DBusConnectionCredsCache, so each
+     *   caller is only looked up once.
      */
     class DBusConnectionCreds : public DBusProxy
     {
@@ -61,6 +246,7 @@ namespace openvpn
         {
             SetGDBusCallFlags(G_DBUS_CALL_FLAGS_NO_AUTO_START);
             proxy = SetupProxy();
+            DBusConnectionCredsCache::Get().Track(GetConnection());
         }
 
 
@@ -75,12 +261,7 @@ namespace openvpn
         {
             try
             {
-                GVariant *result = Call("GetConnectionUnixUser",
-                                      g_variant_new("(s)", busname.c_str()));
-                uid_t ret;
-                g_variant_get(result, "(u)", &ret);
-                g_variant_unref(result);
-                return ret;
+                return get_credentials(busname).uid;
             }
             catch (DBusException& excp)
             {
@@ -102,12 +283,7 @@ namespace openvpn
         {
             try
             {
-                GVariant *result = Call("GetConnectionUnixProcessID",
-                                      g_variant_new("(s)", busname.c_str()));
-                pid_t ret;
-                g_variant_get(result, "(u)", &ret);
-                g_variant_unref(result);
-                return ret;
+                return get_credentials(busname).pid;
             }
             catch (DBusException& excp)
             {
@@ -116,6 +292,79 @@ namespace openvpn
                                     + busname + "': " + excp.getRawError());
             }
         }
+
+
+    private:
+        /**
+         *  Retrieves the credentials of a bus name, from the cache if
+         *  available.  Otherwise both the UID and PID are retrieved in a
+         *  single GetConnectionCredentials call.  If the D-Bus daemon
+         *  does not support that method, the UID and PID are retrieved
+         *  separately.
+         *
+         * @param busname  String containing the bus name for the query
+         * @return Returns a Credentials struct with the UID and PID.
+         *         In case of errors, a DBusException is thrown.
+         */
+        DBusConnectionCredsCache::Credentials get_credentials(const std::string& busname)
+        {
+            DBusConnectionCredsCache::Credentials creds;
+            DBusConnectionCredsCache& cache = DBusConnectionCredsCache::Get();
+            unsigned long disconnects = cache.GetDisconnects(GetConnection());
+            if (cache.Lookup(GetConnection(), busname, creds))
+            {
+                return creds;
+            }
+
+            GVariant *result = nullptr;
+            try
+            {
+                result = Call("GetConnectionCredentials",
+                              g_variant_new("(s)", busname.c_str()));
+            }
+            catch (DBusException&)
+            {
+                result = nullptr;
+            }
+
+            guint32 uid = 0;
+            guint32 pid = 0;
+            GVariant *dict = (result ? g_variant_get_child_value(result, 0) : nullptr);
+            if (dict
+                && g_variant_lookup(dict, "UnixUserID", "u", &uid)
+                && g_variant_lookup(dict, "ProcessID", "u", &pid))
+            {
+                g_variant_unref(dict);
+                g_variant_unref(result);
+            }
+            else
+            {
+                if (dict)
+                {
+                    g_variant_unref(dict);
+                }
+                if (result)
+                {
+                    g_variant_unref(result);
+                }
+
+                // Older D-Bus daemons lacks GetConnectionCredentials
+                result = Call("GetConnectionUnixUser",
+                              g_variant_new("(s)", busname.c_str()));
+                g_variant_get(result, "(u)", &uid);
+                g_variant_unref(result);
+
+                result = Call("GetConnectionUnixProcessID",
+                              g_variant_new("(s)", busname.c_str()));
+                g_variant_get(result, "(u)", &pid);
+                g_variant_unref(result);
+            }
+
+            creds.uid = (uid_t) uid;
+            creds.pid = (pid_t) pid;
+            cache.Store(GetConnection(), busname, creds, disconnects);
+            return creds;
+        }
     };
 
 
@@ -241,6 +490,17 @@ private:
         }
 
 
+        /**
+         *  Returns this objects owner's UID
+         *
+         * @return Returns an uid_t containing the UID
+         */
+        uid_t GetOwnerUID() const
+        {
+            return owner;
+        }
+
+
         /**
          *  Sets the public access attribute.  If set to true,
          *  the ACL check is effectively disabled - unless a
@@ -251,6 +511,7 @@ private:
          */
         void SetPublicAccess(bool public_access)
         {
+            std::lock_guard<std::mutex> guard(acl_mtx);
             acl_public = public_access;
         }
 
@@ -262,6 +523,7 @@ private:
          */
         GVariant * GetPublicAccess()
         {
+            std::lock_guard<std::mutex> guard(acl_mtx);
             return g_variant_new_boolean(acl_public);
         }
 
@@ -276,6 +538,7 @@ private:
         {
             GVariant *ret = NULL;
             GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("au"));
+            std::lock_guard<std::mutex> guard(acl_mtx);
             for (auto& e : acl_list)
             {
                 g_variant_builder_add(bld, "u", e);
@@ -294,6 +557,7 @@ private:
          */
         void GrantAccess(uid_t uid)
         {
+            std::lock_guard<std::mutex> guard(acl_mtx);
             for (auto& acl_uid : acl_list)
             {
                 if (acl_uid == uid)
@@ -315,6 +579,7 @@ private:
          */
         void RevokeAccess(uid_t uid)
         {
+            std::lock_guard<std::mutex> guard(acl_mtx);
             for (auto& acl_uid : acl_list)
             {
                 if (acl_uid == uid)
@@ -372,6 +637,7 @@ private:
 
     private:
         uid_t owner;
+        std::mutex acl_mtx;  /**< Protects acl_public and acl_list */
         bool acl_public;
         std::vector<uid_t> acl_list;
 
@@ -395,11 +661,15 @@ private:
          */
         void check_acl(const std::string sender, bool owner_only, bool allow_root)
         {
-            if (acl_public && !owner_only)
             {
-                return;
+                std::lock_guard<std::mutex> guard(acl_mtx);
+                if (acl_public && !owner_only)
+                {
+                    return;
+                }
             }
 
+            // The lock is not held while the D-Bus daemon is queried
             uid_t sender_uid = GetUID(sender);
 
             if (sender_uid == owner)
@@ -420,6 +690,7 @@ private:
                                                );
             }
 
+            std::lock_guard<std::mutex> guard(acl_mtx);
             for (auto& acl_uid : acl_list)
             {
                 if (acl_uid == sender_uid)
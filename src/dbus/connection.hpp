@@ -81,6 +81,27 @@ namespace openvpn
         }
 
 
+        /**
+         *  Creates a new connection object sharing the D-Bus connection of
+         *  an existing one.  The copy will never close nor release the
+         *  shared connection, and it cannot be used to own a bus name.
+         */
+        DBus(DBus const & orig)
+            : keep_connection(orig.connected),
+              idle_checker(nullptr),
+              bus_type(orig.bus_type),
+              connected(orig.connected),
+              connection_only(true),
+              setup_complete(true),
+              busname(orig.busname),
+              root_path(orig.root_path),
+              default_interface(orig.default_interface),
+              dbuscon(orig.dbuscon),
+              busid(0)
+        {
+        }
+
+
         virtual ~DBus()
         {
             close_and_cleanup();
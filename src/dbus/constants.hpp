@@ -55,6 +55,7 @@ const std::string OpenVPN3DBus_interf_backends_manager = OpenVPN3DBus_interf_bac
 const std::string OpenVPN3DBus_name_backends_be = "net.openvpn.v3.backends.be";
 const std::string OpenVPN3DBus_rootp_backends_sessions =  OpenVPN3DBus_rootp_backends + "/sessions";
 const std::string OpenVPN3DBus_rootp_backends_manager = OpenVPN3DBus_rootp_backends + "/manager";
+const std::string OpenVPN3DBus_rootp_backends_warm = OpenVPN3DBus_rootp_backends + "/warm";
 
 /**
  *  Status - major codes
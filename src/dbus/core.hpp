@@ -25,8 +25,10 @@
 #include "dbus/constants.hpp"
 #include "dbus/exceptions.hpp"
 #include "dbus/object.hpp"
+#include "dbus/subtree.hpp"
 #include "dbus/connection.hpp"
 #include "dbus/proxy.hpp"
+#include "dbus/peerserver.hpp"
 #include "dbus/signals.hpp"
 #include "dbus/processwatch.hpp"
 
@@ -20,13 +20,25 @@
 #ifndef OPENVPN3_DBUS_IDLECHECK_HPP
 #define OPENVPN3_DBUS_IDLECHECK_HPP
 
-#include <memory>
-#include <thread>
+#include <atomic>
+#include <chrono>
+#include <mutex>
 
 #include <openvpn/common/rc.hpp>
 
 using namespace openvpn;
 
+/**
+ *  Stops a GLib main loop when the service has been idle for a given
+ *  time.  A service is idle when no objects holds a reference via
+ *  RefCountInc() and UpdateTimestamp() has not been called within the
+ *  idle time.
+ *
+ *  The check runs as a GSource in the main loop context, which is woken
+ *  up exactly when the idle time may have passed.  If the timestamp was
+ *  updated meanwhile, the source is re-armed to the new deadline.  While
+ *  references are held, the source is not woken up at all.
+ */
 class IdleCheck : public RC<thread_safe_refcount>
 {
 public:
@@ -34,51 +46,72 @@ public:
 
     IdleCheck(GMainLoop *mainloop, std::chrono::duration<double> idle_time)
         : mainloop(mainloop),
-          idle_time(idle_time),
-          poll_time(idle_time),
+          idle_time(std::chrono::duration_cast<std::chrono::microseconds>(idle_time).count()),
           enabled(false),
-          running(false),
-          refcount(0)
+          refcount(0),
+          source(nullptr)
     {
             UpdateTimestamp();
     }
 
 
-    void UpdateTimestamp()
+    ~IdleCheck()
     {
-        last_operation = std::chrono::system_clock::now();
+        Disable();
     }
 
 
-    void SetPollTime(std::chrono::duration<double> pollt)
+    void UpdateTimestamp()
     {
-        poll_time = pollt;
+        // The deadline only moves forward here, so the source does not
+        // need to be woken up.  It re-arms itself when it fires.
+        last_operation = g_get_monotonic_time();
     }
 
 
     void Enable()
     {
-        if (running)
-        {
-            return;
-        }
-
+        std::lock_guard<std::mutex> guard(mtx);
         if (enabled)
         {
             return;
         }
 
+        static GSourceFuncs funcs = {
+            NULL,  // prepare
+            NULL,  // check
+            _cb_dispatch,
+            NULL   // finalize
+        };
+        source = g_source_new(&funcs, sizeof(GSource));
+        g_source_set_callback(source, _cb_idle_timeout, new Ptr(this),
+                              _cb_release);
+        g_source_set_ready_time(source, last_operation + idle_time);
+        g_source_attach(source, g_main_loop_get_context(mainloop));
         enabled = true;
-        idle_checker.reset(new std::thread([self=Ptr(this)]()
-                           {
-                               self->_cb_idlechecker__loop();
-                           }));
     }
 
 
+    /**
+     *  Stops the idle checking.  This takes effect immediately.
+     */
     void Disable()
     {
-        enabled = false;
+        GSource *src = nullptr;
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            enabled = false;
+            src = source;
+            source = nullptr;
+        }
+
+        // Destroying the source may release the last reference to
+        // this object, so this must happen without holding the lock
+        if (src)
+        {
+            g_source_destroy(src);
+            g_source_unref(src);
+        }
     }
 
 
@@ -90,44 +123,97 @@ public:
 
     void RefCountDec()
     {
-        refcount--;
+        if (0 == --refcount)
+        {
+            // The last reference is gone; the idle time starts now
+            UpdateTimestamp();
+            rearm();
+        }
     }
 
 
+    /**
+     *  Waits for the idle checking to complete.  As the checking runs
+     *  inside the main loop, there is nothing left to wait for once the
+     *  main loop has stopped and Disable() has been called.
+     */
     void Join()
     {
-        idle_checker->join();
+        Disable();
+    }
+
+
+private:
+    GMainLoop *mainloop;
+    gint64 idle_time;
+    std::atomic<bool> enabled;
+    std::atomic<unsigned int> refcount;
+    std::atomic<gint64> last_operation;
+    std::mutex mtx;
+    GSource *source;
+
+
+    void rearm()
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        if (source)
+        {
+            g_source_set_ready_time(source, last_operation + idle_time);
+        }
     }
 
 
-    void _cb_idlechecker__loop()
+    gboolean check_idle()
     {
-        running = true;
-        while( enabled )
+        std::lock_guard<std::mutex> guard(mtx);
+        if (!enabled || !source)
+        {
+            return G_SOURCE_REMOVE;
+        }
+
+        if (refcount > 0)
         {
-            // FIXME: Consider to swap sleep_for() with
-            // std::condition_variable::wait_for() which can
-            // unlock on cv.notify_one() call.
-            std::this_thread::sleep_for(poll_time);
-            auto now = std::chrono::system_clock::now();
-            if (0 == refcount && (last_operation + idle_time) < now)
+            // Sleep until the last reference is released.  Check again
+            // afterwards, in case that happened meanwhile.
+            g_source_set_ready_time(source, -1);
+            if (refcount > 0)
             {
-                // We timed out, start the main loop shutdown
-                g_main_loop_quit(mainloop);
-                enabled = false;
+                return G_SOURCE_CONTINUE;
             }
         }
-        running = false;
+
+        gint64 deadline = last_operation + idle_time;
+        if (g_get_monotonic_time() < deadline)
+        {
+            g_source_set_ready_time(source, deadline);
+            return G_SOURCE_CONTINUE;
+        }
+
+        // We timed out, start the main loop shutdown
+        g_main_loop_quit(mainloop);
+        enabled = false;
+        g_source_unref(source);
+        source = nullptr;
+        return G_SOURCE_REMOVE;
     }
 
-private:
-    GMainLoop *mainloop;
-    std::chrono::duration<double> idle_time;
-    std::chrono::duration<double> poll_time;
-    bool enabled;
-    bool running;
-    uint16_t refcount;
-    std::chrono::time_point<std::chrono::system_clock> last_operation;
-    std::unique_ptr<std::thread> idle_checker;
+
+    static gboolean _cb_dispatch(GSource *src, GSourceFunc callback,
+                                 gpointer data)
+    {
+        return callback(data);
+    }
+
+
+    static gboolean _cb_idle_timeout(gpointer data)
+    {
+        return (*(Ptr *) data)->check_idle();
+    }
+
+
+    static void _cb_release(gpointer data)
+    {
+        delete (Ptr *) data;
+    }
 };
 #endif // OPENVPN3_DBUS_IDLECHECK_HPP
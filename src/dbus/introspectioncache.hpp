@@ -0,0 +1,138 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2018      OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2018      David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   introspectioncache.hpp
+ *
+ * @brief  Process wide registry of parsed D-Bus introspection documents
+ */
+
+#ifndef OPENVPN3_DBUS_INTROSPECTIONCACHE_HPP
+#define OPENVPN3_DBUS_INTROSPECTIONCACHE_HPP
+
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace openvpn
+{
+    /**
+     *  Keeps parsed GDBusNodeInfo objects, keyed by the introspection XML
+     *  document they were parsed from.  All DBusObject instances of the
+     *  same class share the same parsed introspection data, as long as
+     *  the XML document does not contain any per-object information,
+     *  such as the object path in the node name.
+     *
+     *  The registry holds a single reference to each GDBusNodeInfo and
+     *  counts the users of each entry itself.  An entry is removed from
+     *  the registry when the last user releases it.
+     */
+    class DBusIntrospectionCache
+    {
+    public:
+        /**
+         *  Retrieve the process wide introspection registry
+         */
+        static DBusIntrospectionCache& Get()
+        {
+            static DBusIntrospectionCache cache;
+            return cache;
+        }
+
+
+        /**
+         *  Retrieve the parsed introspection data of an XML document.
+         *  The document is only parsed if it has not been seen before.
+         *
+         * @param xmlstr  std::string containing the introspection XML
+         *
+         * @return  Returns a GDBusNodeInfo pointer.  This must be released
+         *          with Release() when no longer needed.
+         */
+        GDBusNodeInfo * Parse(const std::string& xmlstr)
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            auto it = cache.find(xmlstr);
+            if (cache.end() != it)
+            {
+                it->second.users++;
+                return it->second.info;
+            }
+
+            GError *error = nullptr;
+            GDBusNodeInfo *info = g_dbus_node_info_new_for_xml(xmlstr.c_str(), &error);
+            if (NULL == info || NULL != error)
+            {
+                std::string errmsg = (error ? error->message : "(unknown)");
+                if (error)
+                {
+                    g_error_free(error);
+                }
+                THROW_DBUSEXCEPTION("DBusIntrospectionCache",
+                                    "Failed to parse introspection XML:" + errmsg);
+            }
+            cache[xmlstr] = {info, 1};
+            keys[info] = xmlstr;
+            return info;
+        }
+
+
+        /**
+         *  Release introspection data retrieved via Parse().  Pointers
+         *  not retrieved via Parse() are ignored.
+         *
+         * @param info  GDBusNodeInfo pointer to release
+         */
+        void Release(GDBusNodeInfo *info) noexcept
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            auto k = keys.find(info);
+            if (keys.end() == k)
+            {
+                return;
+            }
+            auto it = cache.find(k->second);
+            if (0 == --it->second.users)
+            {
+                cache.erase(it);
+                keys.erase(k);
+                g_dbus_node_info_unref(info);
+            }
+        }
+
+
+    private:
+        struct Entry
+        {
+            GDBusNodeInfo *info;
+            unsigned int users;  /**< Callers of Parse() not yet released */
+        };
+
+        std::mutex mtx;
+        std::unordered_map<std::string, Entry> cache;
+        std::map<GDBusNodeInfo *, std::string> keys;
+
+
+        DBusIntrospectionCache()
+        {
+        }
+    };
+};
+
+#endif // OPENVPN3_DBUS_INTROSPECTIONCACHE_HPP
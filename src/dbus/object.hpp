@@ -20,10 +20,20 @@
 #ifndef OPENVPN3_DBUS_OBJECT_HPP
 #define OPENVPN3_DBUS_OBJECT_HPP
 
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
 #include "idlecheck.hpp"
+#include "introspectioncache.hpp"
+#include "workerpool.hpp"
 
 namespace openvpn
 {
+    class DBusSubtree;
+
     /**
      *  DBusObject is the object which carries data, methods
      *  and signals to be provided over the D-Bus.
@@ -51,12 +61,15 @@ namespace openvpn
      */
     class DBusObject
     {
+        friend class DBusSubtree;
+
     public:
         DBusObject(std::string obj_path, std::string introspection_xml) :
             registered(false),
             object_path(obj_path),
             object_id(0),
-            idle_checker(nullptr)
+            idle_checker(nullptr),
+            introspection(NULL)
         {
             ParseIntrospectionXML(introspection_xml);
         }
@@ -121,6 +134,79 @@ namespace openvpn
         }
 
 
+        /**
+         *  Marks this object as served by a DBusSubtree.  The object
+         *  is not registered on the D-Bus on its own; the DBusSubtree
+         *  registered for the parent object path dispatches the calls
+         *  to this object.  RemoveObject() must still be called before
+         *  the object is deleted.
+         */
+        void RegisterSubtreeObject()
+        {
+            if (registered)
+            {
+                THROW_DBUSEXCEPTION("DBusObject", "Object is already registered in D-Bus");
+            }
+            if (NULL == introspection)
+            {
+                THROW_DBUSEXCEPTION("DBusObject", "No introspection document parsed");
+            }
+            registered = true;
+        }
+
+
+        /**
+         *  Registers this object on an additional peer-to-peer D-Bus
+         *  connection, such as a connection accepted by DBusPeerServer.
+         *  The object must already be registered via RegisterObject().
+         *  Callers on peer connections have no bus name, so the sender
+         *  is an empty string in all callbacks.
+         *
+         *  @param peercon  GDBusConnection of the peer connection
+         */
+        void RegisterPeerObject(GDBusConnection *peercon)
+        {
+            if (!registered)
+            {
+                THROW_DBUSEXCEPTION("DBusObject", "Object have not been registered to D-Bus yet");
+            }
+
+            GError *error = NULL;
+            guint id = g_dbus_connection_register_object(peercon,
+                                                         object_path.c_str(),
+                                                         introspection->interfaces[0],
+                                                         &dbusobj_interface_vtable,
+                                                         this,
+                                                         NULL, // destruct function
+                                                         &error);
+            if (id < 1)
+            {
+                std::stringstream err;
+                err << "RegisterPeerObject(" + object_path + ") failed: ";
+                err << (error != NULL ? error->message : "(unknown)");
+                THROW_DBUSEXCEPTION("DBusObject", err.str());
+            }
+            peer_object_ids[peercon] = id;
+        }
+
+
+        /**
+         *  Removes this object from a peer-to-peer D-Bus connection
+         *
+         *  @param peercon  GDBusConnection of the peer connection
+         */
+        void RemovePeerObject(GDBusConnection *peercon) noexcept
+        {
+            auto it = peer_object_ids.find(peercon);
+            if (peer_object_ids.end() == it)
+            {
+                return;
+            }
+            g_dbus_connection_unregister_object(peercon, it->second);
+            peer_object_ids.erase(it);
+        }
+
+
         /**
          *  Sets/registers an IdleChecker object for this DBusObject
          *
@@ -132,6 +218,72 @@ namespace openvpn
         }
 
 
+        /**
+         *  Run the method handlers registered via RegisterMethod() in a
+         *  worker pool instead of in the main loop.  The method calls are
+         *  completed asynchronously by the worker threads.  All method
+         *  calls on this object are serialized; only one runs at a time.
+         *  Property callbacks are still run in the main loop.
+         *
+         *  This must be enabled before the object is registered on the
+         *  D-Bus.
+         *
+         *  @param pool  DBusWorkerPool::Ptr to the worker pool to use
+         */
+        void EnableWorkerPool(DBusWorkerPool::Ptr pool)
+        {
+            if (registered)
+            {
+                THROW_DBUSEXCEPTION("DBusObject",
+                                    "Worker pool must be enabled before registering the object");
+            }
+            worker_pool = pool;
+            worker_strand = pool->NewStrand();
+        }
+
+
+        /**
+         *  Run a task serialized with the method calls of this object.  If
+         *  the worker pool is not enabled, the task is run immediately.
+         *
+         *  @param task  std::function to run
+         *
+         *  @return  Returns false if the task could not be queued, which
+         *           happens when the object has been removed
+         */
+        bool RunSerialized(std::function<void()> task)
+        {
+            if (!worker_pool)
+            {
+                task();
+                return true;
+            }
+            DBusWorkerPool::Task t;
+            t.run = task;
+            return worker_pool->Post(worker_strand, t);
+        }
+
+
+        /**
+         *  Calls a function once no worker thread is running or has
+         *  queued work for this object.  If there is no work in progress,
+         *  or the worker pool is not enabled, the function is called
+         *  immediately.  Otherwise it is called from the worker thread
+         *  completing the last task.
+         *
+         *  @param callback  std::function to call
+         */
+        void RunWhenIdle(std::function<void()> callback)
+        {
+            if (!worker_pool)
+            {
+                callback();
+                return;
+            }
+            worker_pool->WhenIdle(worker_strand, callback);
+        }
+
+
         void RemoveObject(GDBusConnection *dbuscon)
         {
             if (!registered)
@@ -140,20 +292,51 @@ namespace openvpn
             }
             registered = false;
 
-            // Remove the object from the D-Bus
-            g_dbus_connection_unregister_object(dbuscon, object_id);
+            // Remove the object from the D-Bus.  Objects served by a
+            // DBusSubtree have no registration of their own
+            if (object_id > 0)
+            {
+                g_dbus_connection_unregister_object(dbuscon, object_id);
+                object_id = 0;
+            }
+            for (auto& peer : peer_object_ids)
+            {
+                g_dbus_connection_unregister_object(peer.first, peer.second);
+            }
+            peer_object_ids.clear();
+
+            // Method calls not yet started will not be run
+            if (worker_pool)
+            {
+                worker_pool->Close(worker_strand);
+            }
 
             // Allow the implementor to add more cleaning up
             callback_destructor();
 
             // Remove the introspection document from memory
-            g_dbus_node_info_unref(introspection);
+            DBusIntrospectionCache::Get().Release(introspection);
             introspection = nullptr;
         }
 
 
         /**
-         *  Called each time a D-Bus client calls an object method
+         *  Method handler function, bound to a specific D-Bus method via
+         *  RegisterMethod().  The params are already validated by GDBus
+         *  against the method signature in the introspection document.
+         */
+        typedef std::function<void(GDBusConnection *conn,
+                                   const gchar *sender,
+                                   GVariant *params,
+                                   GDBusMethodInvocation *invoc)> MethodHandler;
+
+
+        /**
+         *  Called each time a D-Bus client calls an object method which
+         *  does not have a handler registered via RegisterMethod().
+         *
+         *  The default implementation returns an unknown method error
+         *  to the caller.
          */
         virtual void callback_method_call(GDBusConnection *conn,
                                           const std::string sender,
@@ -161,7 +344,37 @@ namespace openvpn
                                           const std::string intf_name,
                                           const std::string meth_name,
                                           GVariant *params,
-                                          GDBusMethodInvocation *invoc) = 0;
+                                          GDBusMethodInvocation *invoc)
+        {
+            g_dbus_method_invocation_return_error(invoc,
+                                                  G_DBUS_ERROR,
+                                                  G_DBUS_ERROR_UNKNOWN_METHOD,
+                                                  "No method named %s is available",
+                                                  meth_name.c_str());
+        }
+
+
+        /**
+         *  Called each time a D-Bus client calls an object method which
+         *  has a handler registered via RegisterMethod().  This can be
+         *  overridden to run common pre-processing or error handling for
+         *  all methods.  The default implementation just runs the handler.
+         *
+         * @param conn     D-Bus connection where the method call occurred
+         * @param sender   D-Bus bus name of the sender of the method call
+         * @param handler  The MethodHandler registered for this method
+         * @param params   GVariant object containing the method arguments
+         * @param invoc    GDBusMethodInvocation where the response/result
+         *                 of the method call will be returned.
+         */
+        virtual void callback_method_dispatch(GDBusConnection *conn,
+                                              const gchar *sender,
+                                              const MethodHandler& handler,
+                                              GVariant *params,
+                                              GDBusMethodInvocation *invoc)
+        {
+            handler(conn, sender, params, invoc);
+        }
 
 
         /**
@@ -193,7 +406,7 @@ namespace openvpn
             try
             {
                 GVariantBuilder *ret = callback_set_property(conn,
-                                                             std::string(sender),
+                                                             std::string(sender ? sender : ""),
                                                              std::string(obj_path),
                                                              std::string(intf_name),
                                                              std::string(property_name),
@@ -343,6 +556,88 @@ namespace openvpn
         }
 
 
+        /**
+         *  Retrieves the values of several readable properties of this
+         *  object in a single a{sv} dictionary.  Each value is retrieved
+         *  via callback_get_property(), so the same access control checks
+         *  applies as for org.freedesktop.DBus.Properties.Get().
+         *  Properties which cannot be retrieved are silently left out.
+         *
+         *  @param conn    D-Bus connection the request arrived on
+         *  @param sender  D-Bus bus name of the requester
+         *  @param fields  std::vector of property names to retrieve.  If
+         *                 empty, all readable properties are retrieved.
+         *  @param exclude std::vector of property names which are not
+         *                 retrieved unless explicitly listed in fields.
+         *
+         *  @return Returns a floating GVariant reference to an a{sv}
+         *          dictionary with all the retrieved property values
+         */
+        GVariant * GetPropertyDict(GDBusConnection *conn,
+                                   const std::string sender,
+                                   const std::vector<std::string>& fields,
+                                   const std::vector<std::string>& exclude = {})
+        {
+            if (NULL == introspection)
+            {
+                THROW_DBUSEXCEPTION("DBusObject", "No introspection document parsed");
+            }
+
+            GDBusInterfaceInfo *intf = introspection->interfaces[0];
+            GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+            for (GDBusPropertyInfo **p = intf->properties; p && *p; p++)
+            {
+                if (!((*p)->flags & G_DBUS_PROPERTY_INFO_FLAGS_READABLE))
+                {
+                    continue;
+                }
+                std::string name((*p)->name);
+                if (fields.empty())
+                {
+                    if (std::find(exclude.begin(), exclude.end(), name) != exclude.end())
+                    {
+                        continue;
+                    }
+                }
+                else if (std::find(fields.begin(), fields.end(), name) == fields.end())
+                {
+                    continue;
+                }
+
+                GError *error = NULL;
+                GVariant *val = NULL;
+                try
+                {
+                    val = callback_get_property(conn, sender, object_path,
+                                                std::string(intf->name),
+                                                name, &error);
+                }
+                catch (DBusException& excp)
+                {
+                    val = NULL;
+                }
+                if (error)
+                {
+                    g_error_free(error);
+                }
+                if (NULL == val)
+                {
+                    continue;
+                }
+
+                // Not all callback_get_property() implementations
+                // returns a floating reference; ensure we own exactly
+                // one reference which is released after being added
+                g_variant_take_ref(val);
+                g_variant_builder_add(bld, "{sv}", name.c_str(), val);
+                g_variant_unref(val);
+            }
+            GVariant *ret = g_variant_builder_end(bld);
+            g_variant_builder_unref(bld);
+            return ret;
+        }
+
+
         /**
          *  This destructor is optional and may be used by implementors to clean up
          *  before this object is deleted from both the D-Bus bus and memory.  This
@@ -367,12 +662,15 @@ namespace openvpn
                                     "Cannot modify the introspection document.");
             }
 
-            GError *error = nullptr;
-            introspection = g_dbus_node_info_new_for_xml(xmlstr.c_str(), &error);
-            if (NULL == introspection || NULL != error)
+            // Identical introspection documents are only parsed once
+            // per process; the parsed result is shared between all
+            // objects using the same document.
+            GDBusNodeInfo *info = DBusIntrospectionCache::Get().Parse(xmlstr);
+            if (introspection)
             {
-                THROW_DBUSEXCEPTION("DBusObject", "Failed to parse introspection XML:" + std::string(error->message));
+                DBusIntrospectionCache::Get().Release(introspection);
             }
+            introspection = info;
         }
 
 
@@ -389,6 +687,96 @@ namespace openvpn
         }
 
 
+        /**
+         *  Issues the org.freedesktop.DBus.Properties.PropertiesChanged
+         *  signal for properties changed by other means than a property
+         *  set operation, such as by a method call.
+         *
+         *  @param conn     D-Bus connection to send the signal on
+         *  @param changes  GVariantBuilder with the changed properties, as
+         *                  prepared by build_set_property_response().  The
+         *                  builder is consumed.
+         */
+        void SignalPropertiesChanged(GDBusConnection *conn,
+                                     GVariantBuilder *changes)
+        {
+            if (NULL == introspection)
+            {
+                g_variant_builder_unref(changes);
+                THROW_DBUSEXCEPTION("DBusObject", "No introspection document parsed");
+            }
+
+            GError *local_err = NULL;
+            g_dbus_connection_emit_signal(conn,
+                                          NULL,
+                                          object_path.c_str(),
+                                          "org.freedesktop.DBus.Properties",
+                                          "PropertiesChanged",
+                                          g_variant_new("(sa{sv}as)",
+                                                        introspection->interfaces[0]->name,
+                                                        changes,
+                                                        NULL),
+                                          &local_err);
+            g_variant_builder_unref(changes);
+            if (local_err)
+            {
+                std::string errmsg(local_err->message);
+                g_error_free(local_err);
+                THROW_DBUSEXCEPTION("DBusObject",
+                                    "Could not signal changed properties on "
+                                    + object_path + ": " + errmsg);
+            }
+        }
+
+
+        /**
+         *  Binds a handler function to a D-Bus method of this object.
+         *  Calls to this method are dispatched directly to the handler
+         *  via a look-up on the method description in the introspection
+         *  document, instead of calling callback_method_call().
+         *
+         *  The input signature is checked against the introspection
+         *  document once, here, instead of on each call.
+         *
+         *  @param method     std::string with the D-Bus method name
+         *  @param signature  std::string with the expected GVariant
+         *                    tuple signature of the input arguments,
+         *                    such as "(ss)" or "()"
+         *  @param handler    MethodHandler to call for this method
+         */
+        void RegisterMethod(const std::string method,
+                            const std::string signature,
+                            MethodHandler handler)
+        {
+            if (NULL == introspection)
+            {
+                THROW_DBUSEXCEPTION("DBusObject", "No introspection document parsed");
+            }
+
+            GDBusMethodInfo *info = g_dbus_interface_info_lookup_method(introspection->interfaces[0],
+                                                                        method.c_str());
+            if (NULL == info)
+            {
+                THROW_DBUSEXCEPTION("DBusObject", "RegisterMethod(" + method + "): "
+                                    + "Method not found in introspection data");
+            }
+
+            std::string insig = "(";
+            for (GDBusArgInfo **arg = info->in_args; arg && *arg; arg++)
+            {
+                insig += (*arg)->signature;
+            }
+            insig += ")";
+            if (signature != insig)
+            {
+                THROW_DBUSEXCEPTION("DBusObject", "RegisterMethod(" + method + "): "
+                                    + "Signature mismatch, expected " + insig
+                                    + " but got " + signature);
+            }
+            method_handlers[info] = handler;
+        }
+
+
         /**
          *  Updates the IdleCheck timer's timestamp to indicate this object have been accessed.
          *  If the IdleCheck object times out, the process is stopped.
@@ -439,6 +827,10 @@ namespace openvpn
         guint object_id;
         IdleCheck *idle_checker;
         GDBusNodeInfo *introspection;
+        std::unordered_map<const GDBusMethodInfo *, MethodHandler> method_handlers;
+        std::map<GDBusConnection *, guint> peer_object_ids;
+        DBusWorkerPool::Ptr worker_pool;
+        DBusWorkerPool::StrandPtr worker_strand;
 
         /**
          *  Callback loook-up table for D-Bus
@@ -450,6 +842,62 @@ namespace openvpn
         };
 
 
+        /**
+         *  Queues a method call to be run by the worker pool.  The
+         *  invocation is completed by the worker thread.
+         */
+        void queue_method_call(GDBusConnection *conn, const gchar *sender,
+                               MethodHandler handler, GVariant *params,
+                               GDBusMethodInvocation *invoc)
+        {
+            // Keep the arguments alive until the task has been run
+            g_object_ref(conn);
+            g_variant_ref(params);
+            bool has_sender = (NULL != sender);
+            std::string sender_s(has_sender ? sender : "");
+
+            DBusWorkerPool::Task task;
+            task.run = [this, conn, has_sender, sender_s, handler, params, invoc]()
+                       {
+                           // The caller must always get a reply.  Errors
+                           // not handled by the method handler are returned
+                           // here, as the handler has then not replied yet.
+                           try
+                           {
+                               callback_method_dispatch(conn,
+                                                        (has_sender ? sender_s.c_str() : NULL),
+                                                        handler, params, invoc);
+                           }
+                           catch (DBusException& excp)
+                           {
+                               g_dbus_method_invocation_return_dbus_error(invoc,
+                                                   "net.openvpn.v3.error.internal",
+                                                   excp.getRawError().c_str());
+                           }
+                           catch (std::exception& excp)
+                           {
+                               g_dbus_method_invocation_return_dbus_error(invoc,
+                                                   "net.openvpn.v3.error.internal",
+                                                   excp.what());
+                           }
+                           g_variant_unref(params);
+                           g_object_unref(conn);
+                       };
+            task.cancel = [conn, params, invoc]()
+                          {
+                              g_dbus_method_invocation_return_dbus_error(invoc,
+                                                  "org.freedesktop.DBus.Error.UnknownObject",
+                                                  "Object was removed");
+                              g_variant_unref(params);
+                              g_object_unref(conn);
+                          };
+            if (!worker_pool->Post(worker_strand, task))
+            {
+                task.cancel();
+            }
+        }
+
+
         static void dbusobject_callback_method_call(GDBusConnection *conn,
                                                      const gchar *sender,
                                                      const gchar *obj_path,
@@ -460,8 +908,25 @@ namespace openvpn
                                                      gpointer this_ptr)
         {
             class DBusObject *obj = (class DBusObject *) this_ptr;
+
+            // The method info pointer uniquely identifies the method
+            // being called, so no string comparisons are needed
+            auto hdl = obj->method_handlers.find(g_dbus_method_invocation_get_method_info(invoc));
+            if (obj->method_handlers.end() != hdl)
+            {
+                if (obj->worker_pool)
+                {
+                    obj->queue_method_call(conn, sender, hdl->second,
+                                           params, invoc);
+                    return;
+                }
+                obj->callback_method_dispatch(conn, sender, hdl->second,
+                                              params, invoc);
+                return;
+            }
+
             obj->callback_method_call(conn,
-                                      std::string(sender),
+                                      std::string(sender ? sender : ""),
                                       std::string(obj_path),
                                       std::string(intf_name),
                                       std::string(meth_name),
@@ -479,7 +944,7 @@ namespace openvpn
         {
             class DBusObject *obj = (class DBusObject *) this_ptr;
             return obj->callback_get_property(conn,
-                                              std::string(sender),
+                                              std::string(sender ? sender : ""),
                                               std::string(obj_path),
                                               std::string(intf_name),
                                               std::string(property_name),
@@ -0,0 +1,286 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2018      OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2018      David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   peerserver.hpp
+ *
+ * @brief  Private peer-to-peer D-Bus server, used for direct connections
+ *         between two processes without passing the D-Bus daemon
+ */
+
+#ifndef OPENVPN3_DBUS_PEERSERVER_HPP
+#define OPENVPN3_DBUS_PEERSERVER_HPP
+
+#include <functional>
+#include <mutex>
+#include <set>
+#include <sys/types.h>
+
+namespace openvpn
+{
+    /**
+     *  Listens on a private unix socket for peer-to-peer D-Bus connections.
+     *  Only peers running with the UID provided to the constructor, or as
+     *  root, are allowed to connect.
+     *
+     *  Each accepted connection is passed to the new_connection callback.
+     *  This is typically used to register DBusObjects on the connection via
+     *  DBusObject::RegisterPeerObject().  When the peer disconnects, the
+     *  closed callback is called.  Peer connections have no message bus, so
+     *  no bus names are used on these connections.
+     */
+    class DBusPeerServer
+    {
+    public:
+        typedef std::function<void(GDBusConnection *conn)> ConnectionCallback;
+
+        /**
+         *  Prepares the peer-to-peer server.  Start() must be called before
+         *  any peer can connect.
+         *
+         * @param allowed_uid     uid_t of the user allowed to connect
+         * @param new_connection  ConnectionCallback called for each
+         *                        accepted connection
+         * @param closed          ConnectionCallback called when an accepted
+         *                        connection is closed
+         */
+        DBusPeerServer(uid_t allowed_uid,
+                       ConnectionCallback new_connection,
+                       ConnectionCallback closed)
+            : allowed_uid(allowed_uid),
+              new_connection_cb(new_connection),
+              closed_cb(closed),
+              server(nullptr),
+              observer(nullptr)
+        {
+        }
+
+
+        ~DBusPeerServer()
+        {
+            Stop();
+        }
+
+
+        /**
+         *  Starts listening for peer connections on a new unix socket
+         *
+         * @param socketdir  std::string with the directory where the unix
+         *                   socket is created
+         */
+        void Start(const std::string socketdir = "/tmp")
+        {
+            if (server)
+            {
+                THROW_DBUSEXCEPTION("DBusPeerServer", "Server already started");
+            }
+
+            observer = g_dbus_auth_observer_new();
+            g_signal_connect(observer, "authorize-authenticated-peer",
+                             G_CALLBACK(_cb_authorize_peer), this);
+
+            gchar *guid = g_dbus_generate_guid();
+            std::string address = "unix:tmpdir=" + socketdir;
+            GError *error = NULL;
+            server = g_dbus_server_new_sync(address.c_str(),
+                                            G_DBUS_SERVER_FLAGS_NONE,
+                                            guid,
+                                            observer,
+                                            NULL,
+                                            &error);
+            g_free(guid);
+            if (!server || error)
+            {
+                std::string errmsg = (error ? error->message : "(unknown)");
+                if (error)
+                {
+                    g_error_free(error);
+                }
+                g_object_unref(observer);
+                observer = nullptr;
+                THROW_DBUSEXCEPTION("DBusPeerServer",
+                                    "Could not start peer-to-peer server: "
+                                    + errmsg);
+            }
+            g_signal_connect(server, "new-connection",
+                             G_CALLBACK(_cb_new_connection), this);
+            g_dbus_server_start(server);
+        }
+
+
+        /**
+         *  Stops the server and closes all established peer connections
+         */
+        void Stop() noexcept
+        {
+            if (!server)
+            {
+                return;
+            }
+            g_dbus_server_stop(server);
+            g_signal_handlers_disconnect_by_data(server, this);
+            g_object_unref(server);
+            server = nullptr;
+            g_object_unref(observer);
+            observer = nullptr;
+
+            std::set<GDBusConnection *> conns;
+            {
+                std::lock_guard<std::mutex> guard(mtx);
+                conns.swap(connections);
+            }
+            for (auto& c : conns)
+            {
+                g_signal_handlers_disconnect_by_data(c, this);
+                closed_cb(c);
+                g_dbus_connection_close(c, NULL, NULL, NULL);
+                g_object_unref(c);
+            }
+        }
+
+
+        /**
+         *  Retrieve the D-Bus address peers must use to connect to this
+         *  server.
+         *
+         * @return  Returns a std::string with the D-Bus address of the
+         *          server, or an empty string if the server is not started.
+         */
+        std::string GetClientAddress()
+        {
+            if (!server)
+            {
+                return "";
+            }
+            return std::string(g_dbus_server_get_client_address(server));
+        }
+
+
+        /**
+         *  Connect to a peer-to-peer server as a client.  This is the
+         *  counterpart of a DBusPeerServer, run in the peer process.
+         *
+         * @param address  std::string with the D-Bus address of the server
+         *
+         * @return  Returns a GDBusConnection pointer to the established
+         *          connection.  The caller owns the reference.  In case of
+         *          errors, a DBusException is thrown.
+         */
+        static GDBusConnection * Connect(const std::string& address)
+        {
+            GError *error = NULL;
+            GDBusConnection *conn = g_dbus_connection_new_for_address_sync(
+                                          address.c_str(),
+                                          G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT,
+                                          NULL,  // GDBusAuthObserver
+                                          NULL,  // GCancellable
+                                          &error);
+            if (!conn || error)
+            {
+                std::string errmsg = (error ? error->message : "(unknown)");
+                if (error)
+                {
+                    g_error_free(error);
+                }
+                THROW_DBUSEXCEPTION("DBusPeerServer",
+                                    "Could not connect to peer '" + address
+                                    + "': " + errmsg);
+            }
+            return conn;
+        }
+
+
+    private:
+        uid_t allowed_uid;
+        ConnectionCallback new_connection_cb;
+        ConnectionCallback closed_cb;
+        GDBusServer *server;
+        GDBusAuthObserver *observer;
+        std::mutex mtx;
+        std::set<GDBusConnection *> connections;
+
+
+        static gboolean _cb_authorize_peer(GDBusAuthObserver *obs,
+                                           GIOStream *stream,
+                                           GCredentials *credentials,
+                                           gpointer this_ptr)
+        {
+            DBusPeerServer *srv = (DBusPeerServer *) this_ptr;
+            if (NULL == credentials)
+            {
+                return FALSE;
+            }
+
+            GError *error = NULL;
+            uid_t uid = g_credentials_get_unix_user(credentials, &error);
+            if (error)
+            {
+                g_error_free(error);
+                return FALSE;
+            }
+            return (0 == uid || srv->allowed_uid == uid);
+        }
+
+
+        static gboolean _cb_new_connection(GDBusServer *server,
+                                           GDBusConnection *conn,
+                                           gpointer this_ptr)
+        {
+            DBusPeerServer *srv = (DBusPeerServer *) this_ptr;
+            {
+                std::lock_guard<std::mutex> guard(srv->mtx);
+                srv->connections.insert(G_DBUS_CONNECTION(g_object_ref(conn)));
+            }
+            g_signal_connect(conn, "closed",
+                             G_CALLBACK(_cb_connection_closed), srv);
+            try
+            {
+                srv->new_connection_cb(conn);
+            }
+            catch (DBusException&)
+            {
+                // Reject the peer, if it could not be set up
+                _cb_connection_closed(conn, TRUE, NULL, srv);
+                return FALSE;
+            }
+            return TRUE;
+        }
+
+
+        static void _cb_connection_closed(GDBusConnection *conn,
+                                          gboolean remote_peer_vanished,
+                                          GError *error,
+                                          gpointer this_ptr)
+        {
+            DBusPeerServer *srv = (DBusPeerServer *) this_ptr;
+            {
+                std::lock_guard<std::mutex> guard(srv->mtx);
+                if (0 == srv->connections.erase(conn))
+                {
+                    return;
+                }
+            }
+            g_signal_handlers_disconnect_by_data(conn, srv);
+            srv->closed_cb(conn);
+            g_object_unref(conn);
+        }
+    };
+};
+
+#endif // OPENVPN3_DBUS_PEERSERVER_HPP
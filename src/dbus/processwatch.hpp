@@ -20,30 +20,133 @@
 #ifndef OPENVPN3_DBUS_PROCESSWATCH_HPP
 #define OPENVPN3_DBUS_PROCESSWATCH_HPP
 
+#include <future>
+#include <map>
+#include <memory>
 #include <mutex>
-#include <condition_variable>
 
 namespace openvpn
 {
+    /**
+     *  Waits for ProcessChange signals from specific processes.  A single
+     *  subscription to the ProcessChange signal is shared by all waiters.
+     *  Any number of waiters may wait in parallel, each identified by
+     *  either a process name or a PID and each with its own timeout.
+     *
+     *  The signals are processed by the GMainContext which was the thread
+     *  default context when the watcher was created.  That context must be
+     *  run by a main loop while waiting.
+     */
     class ProcessSignalWatcher : public DBusSignalSubscription
     {
     public:
         ProcessSignalWatcher(GDBusConnection *dbuscon)
             : DBusSignalSubscription(dbuscon, "", "", "/", "ProcessChange"),
-              waitfor_inuse(false)
+              context(g_main_context_ref_thread_default()),
+              last_waiter_id(0)
         {
         }
 
 
+        ~ProcessSignalWatcher()
+        {
+            Cleanup();
+
+            std::lock_guard<std::mutex> guard(mtx);
+            for (auto& w : waiters)
+            {
+                g_source_destroy(w.second->timer);
+                g_source_unref(w.second->timer);
+                w.second->result.set_value(StatusMinor::UNSET);
+            }
+            waiters.clear();
+            g_main_context_unref(context);
+        }
+
+
+        /**
+         *  Waits for a process with a given process name to send a
+         *  ProcessChange signal.
+         *
+         * @param interface  std::string with the D-Bus interface of the
+         *                   process, an empty string matches all interfaces
+         * @param procname   std::string with the process name to wait for
+         * @param timeout    Number of seconds to wait
+         *
+         * @return  Returns the StatusMinor value of the signal, or
+         *          StatusMinor::UNSET if the timeout was reached.
+         */
         StatusMinor WaitForProcess(std::string interface, std::string procname, uint8_t timeout = 10)
         {
-            return start_wait(interface, procname, 0, timeout);
+            return wait(WaitForProcessAsync(interface, procname, timeout), timeout);
         }
 
 
+        /**
+         *  Waits for a process with a given PID to send a ProcessChange
+         *  signal.
+         *
+         * @param interface  std::string with the D-Bus interface of the
+         *                   process, an empty string matches all interfaces
+         * @param pid        pid_t of the process to wait for
+         * @param timeout    Number of seconds to wait
+         *
+         * @return  Returns the StatusMinor value of the signal, or
+         *          StatusMinor::UNSET if the timeout was reached.
+         */
         StatusMinor WaitForProcess(std::string interface, pid_t pid, uint8_t timeout = 10)
         {
-            return start_wait(interface, "", pid, timeout);
+            return wait(WaitForProcessAsync(interface, pid, timeout), timeout);
+        }
+
+
+        /**
+         *  Registers a waiter for a ProcessChange signal from a process
+         *  with a given process name, without blocking.
+         *
+         * @param interface  std::string with the D-Bus interface of the
+         *                   process, an empty string matches all interfaces
+         * @param procname   std::string with the process name to wait for
+         * @param timeout    Number of seconds to wait
+         *
+         * @return  Returns a std::future which provides the StatusMinor
+         *          value of the signal, or StatusMinor::UNSET if the
+         *          timeout was reached.
+         */
+        std::future<StatusMinor> WaitForProcessAsync(std::string interface,
+                                                     std::string procname,
+                                                     uint8_t timeout = 10)
+        {
+            if (procname.empty())
+            {
+                THROW_DBUSEXCEPTION("ProcessSignalWatcher", "Process name *OR* PID must be set");
+            }
+            return add_waiter(interface, procname, 0, timeout);
+        }
+
+
+        /**
+         *  Registers a waiter for a ProcessChange signal from a process
+         *  with a given PID, without blocking.
+         *
+         * @param interface  std::string with the D-Bus interface of the
+         *                   process, an empty string matches all interfaces
+         * @param pid        pid_t of the process to wait for
+         * @param timeout    Number of seconds to wait
+         *
+         * @return  Returns a std::future which provides the StatusMinor
+         *          value of the signal, or StatusMinor::UNSET if the
+         *          timeout was reached.
+         */
+        std::future<StatusMinor> WaitForProcessAsync(std::string interface,
+                                                     pid_t pid,
+                                                     uint8_t timeout = 10)
+        {
+            if (pid < 1)
+            {
+                THROW_DBUSEXCEPTION("ProcessSignalWatcher", "Process name *OR* PID must be set");
+            }
+            return add_waiter(interface, "", pid, timeout);
         }
 
 
@@ -59,79 +162,121 @@ namespace openvpn
                 return;
             }
 
-            StatusMinor status;
+            guint32 status = 0;
             gchar *procname_p = NULL;
-            pid_t pid;
+            guint32 pid = 0;
             g_variant_get(parameters, "(usu)", &status, &procname_p, &pid);
             std::string procname(procname_p);
+            g_free(procname_p);
 
-            if (!waitfor_process_name.empty() && (procname != waitfor_process_name))
+            std::lock_guard<std::mutex> guard(mtx);
+            auto it = waiters.begin();
+            while (waiters.end() != it)
             {
-                // Not the process name we're waiting for
-                return;
+                Waiter& w = *it->second;
+                if ((!w.interface.empty() && w.interface != interface_name)
+                    || (!w.process_name.empty() && w.process_name != procname)
+                    || (w.pid > 0 && w.pid != (pid_t) pid))
+                {
+                    // Not the process this waiter is waiting for
+                    ++it;
+                    continue;
+                }
+
+                g_source_destroy(w.timer);
+                g_source_unref(w.timer);
+                w.result.set_value((StatusMinor) status);
+                it = waiters.erase(it);
             }
-
-            if (waitfor_pid > 0 && (pid != waitfor_pid))
-            {
-                // Not the process name we're waiting for
-                return;
-            }
-
-            waitfor_result = status;
-            waitfor_signaled = true;
-            std::unique_lock<std::mutex> lock(waitfor_mtx);
-            lock.unlock();
-            waitfor_condvar.notify_one();
         }
 
 
     private:
-        std::mutex waitfor_mtx;
-        std::condition_variable waitfor_condvar;
-        bool waitfor_inuse;
-        StatusMinor waitfor_result;
-        std::string waitfor_process_name;
-        pid_t waitfor_pid;
-        bool waitfor_signaled;
+        struct Waiter
+        {
+            std::string interface;
+            std::string process_name;
+            pid_t pid;
+            GSource *timer;
+            std::promise<StatusMinor> result;
+        };
+
+        struct TimerData
+        {
+            ProcessSignalWatcher *watcher;
+            guint64 waiter_id;
+        };
+
+        std::mutex mtx;
+        GMainContext *context;
+        guint64 last_waiter_id;
+        std::map<guint64, std::unique_ptr<Waiter>> waiters;
+
+
+        std::future<StatusMinor> add_waiter(const std::string& interface,
+                                            const std::string& process_name,
+                                            pid_t pid, uint8_t timeout)
+        {
+            std::unique_ptr<Waiter> w(new Waiter());
+            w->interface = interface;
+            w->process_name = process_name;
+            w->pid = pid;
+            std::future<StatusMinor> ret = w->result.get_future();
+
+            std::lock_guard<std::mutex> guard(mtx);
+            TimerData *td = new TimerData;
+            td->watcher = this;
+            td->waiter_id = ++last_waiter_id;
+
+            w->timer = g_timeout_source_new_seconds(timeout);
+            g_source_set_callback(w->timer, _cb_timeout, td, _cb_timer_free);
+            waiters[td->waiter_id] = std::move(w);
+            g_source_attach(waiters[td->waiter_id]->timer, context);
+            return ret;
+        }
+
 
-        StatusMinor start_wait(std::string interface, std::string process_name, pid_t pid, uint8_t timeout)
+        /**
+         *  Blocks until a waiter has a result.  The main loop may not be
+         *  running anymore, so the deadline is also enforced here.
+         */
+        StatusMinor wait(std::future<StatusMinor> result, uint8_t timeout)
         {
-            if ((process_name.empty() && pid == 0) || (!process_name.empty() && pid > 0))
+            if (std::future_status::ready == result.wait_for(std::chrono::seconds(timeout)))
             {
-                THROW_DBUSEXCEPTION("ProcessSignalWatcher", "Process name *OR* PID must be set");
+                return result.get();
             }
+            return StatusMinor::UNSET;
+        }
+
 
-            if (waitfor_inuse)
+        void expire(guint64 waiter_id)
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            auto it = waiters.find(waiter_id);
+            if (waiters.end() == it)
             {
-                THROW_DBUSEXCEPTION("ProcessSignalWatcher", "A WaitForProcess() call is already running.");
+                return;
             }
-            waitfor_inuse = true;
-
-            // Subscribe for StatusChange signals on the provided interface
-            waitfor_process_name = process_name;
-            waitfor_result = StatusMinor::UNSET;
-            waitfor_signaled = false;
-            waitfor_pid = pid;
-
-            guint signal_id = g_dbus_connection_signal_subscribe(GetConnection(), NULL, interface.c_str(),
-                                                                 "ProcessChange", "/",
-                                                                 NULL,
-                                                                 G_DBUS_SIGNAL_FLAGS_NONE,
-                                                                 dbusobject_callback_signal_handler,
-                                                                 this,
-                                                                 NULL);
-            std::unique_lock<std::mutex> lock(waitfor_mtx);
-            waitfor_condvar.wait_for(lock, std::chrono::seconds(timeout),
-                                     [this]{return true == waitfor_signaled;});
-
-            g_dbus_connection_signal_unsubscribe(GetConnection(), signal_id);
-
-            StatusMinor ret = waitfor_result;  // To avoid another caller to clobbering our result
-            waitfor_inuse = false;
-            return ret;
+            // The timer source is destroyed when this callback returns
+            g_source_unref(it->second->timer);
+            it->second->result.set_value(StatusMinor::UNSET);
+            waiters.erase(it);
+        }
+
 
+        static gboolean _cb_timeout(gpointer data)
+        {
+            TimerData *td = (TimerData *) data;
+            td->watcher->expire(td->waiter_id);
+            return G_SOURCE_REMOVE;
         }
 
+
+        static void _cb_timer_free(gpointer data)
+        {
+            delete (TimerData *) data;
+        }
     };
 
 
@@ -20,8 +20,368 @@
 #ifndef OPENVPN3_DBUS_PROXY_HPP
 #define OPENVPN3_DBUS_PROXY_HPP
 
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <map>
+#include <memory>
+#include <utility>
+
+#include "proxypool.hpp"
+
 namespace openvpn
 {
+    /**
+     *  Tracks a single asynchronous D-Bus method call started by
+     *  DBusProxy::CallAsync() or DBusProxy::GetPropertyAsync().
+     *
+     *  The call is completed by the GMainContext which was the thread
+     *  default context when the call was issued.  If no main loop is
+     *  running in that context, Wait() will iterate it until the call
+     *  has completed.  This makes it possible to issue several calls
+     *  at once and only pay for a single round-trip when waiting for
+     *  all of them.
+     */
+    class DBusPendingCall : public RC<thread_safe_refcount>
+    {
+    public:
+        typedef RCPtr<DBusPendingCall> Ptr;
+        typedef std::function<void(DBusPendingCall& call)> Completed;
+
+        DBusPendingCall(std::string const & method, Completed cb,
+                        bool unwrap_variant = false)
+            : method(method),
+              completed_cb(cb),
+              unwrap_variant(unwrap_variant),
+              cancellable(g_cancellable_new()),
+              context(g_main_context_ref_thread_default()),
+              done(false),
+              result(nullptr),
+              error(nullptr)
+        {
+        }
+
+
+        ~DBusPendingCall()
+        {
+            if (result)
+            {
+                g_variant_unref(result);
+            }
+            if (error)
+            {
+                g_error_free(error);
+            }
+            g_object_unref(cancellable);
+            g_main_context_unref(context);
+        }
+
+
+        /**
+         *  Retrieve the D-Bus method name this call was issued for
+         *
+         * @return  std::string containing the method name
+         */
+        std::string GetMethod() const noexcept
+        {
+            return method;
+        }
+
+
+        /**
+         *  Check if a response (or an error) has been received
+         *
+         * @return  Returns true if the call has completed
+         */
+        bool IsDone() noexcept
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            return done;
+        }
+
+
+        /**
+         *  Cancel a call still in progress.  The call will complete
+         *  with a G_IO_ERROR_CANCELLED error.
+         */
+        void Cancel() noexcept
+        {
+            g_cancellable_cancel(cancellable);
+        }
+
+
+        /**
+         *  Block until this call has completed.  If the main context
+         *  used for this call is not owned by another thread, it will
+         *  be iterated until the response has arrived.
+         */
+        void Wait()
+        {
+            if (g_main_context_acquire(context))
+            {
+                while (!IsDone())
+                {
+                    g_main_context_iteration(context, TRUE);
+                }
+                g_main_context_release(context);
+            }
+            else
+            {
+                // Another thread runs the main loop for this context;
+                // it will complete the call for us.
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [this]{ return done; });
+            }
+        }
+
+
+        /**
+         *  Waits for all the given calls to complete.  As all the calls
+         *  are already in flight, the total waiting time is roughly the
+         *  time of the slowest call and not the sum of all of them.
+         *
+         * @param calls  std::vector of DBusPendingCall::Ptr to wait for
+         */
+        static void WaitAll(std::vector<Ptr>& calls)
+        {
+            for (auto& c : calls)
+            {
+                c->Wait();
+            }
+        }
+
+
+        /**
+         *  Check if the call failed.  This will wait for the call to
+         *  complete.
+         *
+         * @return  Returns true if the call failed, was cancelled or
+         *          timed out.
+         */
+        bool Failed()
+        {
+            Wait();
+            return nullptr != error;
+        }
+
+
+        /**
+         *  Retrieve the response of the call.  This will wait for the
+         *  call to complete.  In case the call failed, a DBusException
+         *  is thrown.
+         *
+         * @return  Returns a GVariant pointer to the response.  The caller
+         *          must call g_variant_unref() on this value, like with
+         *          the result of DBusProxy::Call().
+         */
+        GVariant * GetResult()
+        {
+            Wait();
+            if (error)
+            {
+                std::stringstream errmsg;
+                errmsg << "Failed calling D-Bus method " << method << ": "
+                       << error->message;
+                THROW_DBUSEXCEPTION("DBusPendingCall", errmsg.str());
+            }
+            return g_variant_ref(result);
+        }
+
+
+    private:
+        friend class DBusProxy;
+
+        std::string method;
+        Completed completed_cb;
+        bool unwrap_variant;
+        GCancellable *cancellable;
+        GMainContext *context;
+        std::mutex mtx;
+        std::condition_variable cv;
+        bool done;
+        GVariant *result;
+        GError *error;
+
+
+        void complete(GDBusProxy *prx, GAsyncResult *res)
+        {
+            GError *err = nullptr;
+            GVariant *ret = g_dbus_proxy_call_finish(prx, res, &err);
+            if (ret && unwrap_variant)
+            {
+                // Strip off the response tuple, and the variant
+                // container of a single property value
+                GVariant *val = g_variant_get_child_value(ret, 0);
+                g_variant_unref(ret);
+                if (g_variant_is_of_type(val, G_VARIANT_TYPE_VARIANT))
+                {
+                    ret = g_variant_get_variant(val);
+                    g_variant_unref(val);
+                }
+                else
+                {
+                    ret = val;
+                }
+            }
+            {
+                std::lock_guard<std::mutex> guard(mtx);
+                result = ret;
+                error = err;
+                done = true;
+            }
+            cv.notify_all();
+
+            if (completed_cb)
+            {
+                completed_cb(*this);
+            }
+        }
+
+
+        /**
+         *  C wrapper function for the g_dbus_proxy_call() completion
+         *  callback.
+         *
+         * @param source     GObject pointer to the GDBusProxy used
+         * @param res        GAsyncResult of this call
+         * @param user_data  Heap allocated DBusPendingCall::Ptr, holding
+         *                   a reference to the call object until the
+         *                   call has completed
+         */
+        static void _cb_call_complete(GObject *source, GAsyncResult *res,
+                                      gpointer user_data)
+        {
+            Ptr *call = static_cast<Ptr *>(user_data);
+            (*call)->complete(G_DBUS_PROXY(source), res);
+            delete call;
+        }
+    };
+
+
+    /**
+     *  A snapshot of all the properties of a D-Bus object, as returned
+     *  by a single org.freedesktop.DBus.Properties.GetAll() call.  The
+     *  values are cached locally and will not be updated if they change
+     *  on the service side.
+     */
+    class DBusPropertySnapshot
+    {
+    public:
+        DBusPropertySnapshot()
+        {
+        }
+
+
+        /**
+         *  Parse the result of org.freedesktop.DBus.Properties.GetAll()
+         *
+         * @param props  GVariant pointer to an a{sv} dictionary.  The
+         *               caller keeps its own reference to this object.
+         */
+        DBusPropertySnapshot(GVariant *props)
+        {
+            if (!g_variant_is_of_type(props, G_VARIANT_TYPE("a{sv}")))
+            {
+                THROW_DBUSEXCEPTION("DBusPropertySnapshot",
+                                    "Invalid property dictionary type");
+            }
+
+            GVariantIter iter;
+            gchar *key = nullptr;
+            GVariant *val = nullptr;
+            g_variant_iter_init(&iter, props);
+            while (g_variant_iter_next(&iter, "{sv}", &key, &val))
+            {
+                values[std::string(key)] = std::shared_ptr<GVariant>(val, g_variant_unref);
+                g_free(key);
+            }
+        }
+
+
+        /**
+         *  Check if a property is present in this snapshot
+         *
+         * @param property  std::string with the property name
+         *
+         * @return  Returns true if the property was retrieved
+         */
+        bool Has(std::string const & property) const noexcept
+        {
+            return values.find(property) != values.end();
+        }
+
+
+        /**
+         *  Retrieve the raw value of a property
+         *
+         * @param property  std::string with the property name
+         *
+         * @return  Returns a GVariant pointer with the property value.
+         *          The caller must release it with g_variant_unref().
+         */
+        GVariant * Get(std::string const & property) const
+        {
+            return g_variant_ref(lookup(property, nullptr));
+        }
+
+
+        bool GetBoolProperty(std::string const & property) const
+        {
+            return g_variant_get_boolean(lookup(property, G_VARIANT_TYPE_BOOLEAN));
+        }
+
+
+        std::string GetStringProperty(std::string const & property) const
+        {
+            return std::string(g_variant_get_string(lookup(property, G_VARIANT_TYPE_STRING),
+                                                    NULL));
+        }
+
+
+        guint32 GetUIntProperty(std::string const & property) const
+        {
+            return g_variant_get_uint32(lookup(property, G_VARIANT_TYPE_UINT32));
+        }
+
+
+        guint64 GetUInt64Property(std::string const & property) const
+        {
+            return g_variant_get_uint64(lookup(property, G_VARIANT_TYPE_UINT64));
+        }
+
+
+    private:
+        std::map<std::string, std::shared_ptr<GVariant>> values;
+
+
+        GVariant * lookup(std::string const & property,
+                          const GVariantType *type) const
+        {
+            auto it = values.find(property);
+            if (values.end() == it)
+            {
+                THROW_DBUSEXCEPTION("DBusPropertySnapshot",
+                                    "Property '" + property + "' not available");
+            }
+            if (type && !g_variant_is_of_type(it->second.get(), type))
+            {
+                THROW_DBUSEXCEPTION("DBusPropertySnapshot",
+                                    "Property '" + property
+                                    + "' has an unexpected type");
+            }
+            return it->second.get();
+        }
+    };
+
+
+    /**
+     *  List of object paths and a property snapshot of each object, as
+     *  returned by the bulk Fetch*Detailed() methods.
+     */
+    typedef std::vector<std::pair<std::string, DBusPropertySnapshot>> DBusPropertySnapshotList;
+
+
     class DBusProxy : public DBus
     {
     public:
@@ -165,22 +525,18 @@ namespace openvpn
 
         virtual ~DBusProxy()
         {
-            // If this object is using an existing connection;
-            // don't trigger a disconnect.  This variable is
-            // defined and set in the DBus class.
-            if (keep_connection)
-            {
-                return;
-            }
-
+            // The GDBusProxy objects are owned by the DBusProxyPool,
+            // which may keep them around for reuse.  Whether the
+            // D-Bus connection is closed or not is decided by
+            // the DBus class.
             if (proxy_init)
             {
-                g_object_unref(proxy);
+                DBusProxyPool::Get().Release(proxy);
             }
 
             if (property_proxy_init)
             {
-                g_object_unref(property_proxy);
+                DBusProxyPool::Get().Release(property_proxy);
             }
         }
 
@@ -238,6 +594,41 @@ namespace openvpn
         }
 
 
+        /**
+         *  Calls a D-Bus method without waiting for the response.
+         *
+         * @param method      std::string with the method name to call
+         * @param params      GVariant pointer to the method arguments, may
+         *                    be NULL
+         * @param timeout_ms  Timeout in milliseconds for this call, -1 for
+         *                    the D-Bus default timeout
+         * @param cb          Optional callback function which is called
+         *                    from the main context once the call completes
+         *
+         * @return  Returns a DBusPendingCall::Ptr which can be used to
+         *          wait for, cancel or retrieve the result of the call.
+         */
+        DBusPendingCall::Ptr CallAsync(std::string method, GVariant *params,
+                                       int timeout_ms = -1,
+                                       DBusPendingCall::Completed cb = nullptr)
+        {
+            if (method.empty())
+            {
+                THROW_DBUSEXCEPTION("DBusProxy", "Method cannot be empty");
+            }
+            return start_async_call(proxy, method, method, params,
+                                    call_flags, timeout_ms, cb, false);
+        }
+
+
+        DBusPendingCall::Ptr CallAsync(std::string method,
+                                       int timeout_ms = -1,
+                                       DBusPendingCall::Completed cb = nullptr)
+        {
+            return CallAsync(method, NULL, timeout_ms, cb);
+        }
+
+
         GVariant * GetProperty(std::string property)
         {
             if (property.empty())
@@ -280,6 +671,99 @@ namespace openvpn
         }
 
 
+        /**
+         *  Retrieves a property value without waiting for the response.
+         *  The result of the returned DBusPendingCall is the property
+         *  value itself, just like GetProperty() returns.
+         *
+         * @param property    std::string with the property name
+         * @param timeout_ms  Timeout in milliseconds for this call, -1 for
+         *                    the D-Bus default timeout
+         * @param cb          Optional completion callback function
+         *
+         * @return  Returns a DBusPendingCall::Ptr for this request
+         */
+        DBusPendingCall::Ptr GetPropertyAsync(std::string property,
+                                              int timeout_ms = -1,
+                                              DBusPendingCall::Completed cb = nullptr)
+        {
+            if (property.empty())
+            {
+                THROW_DBUSEXCEPTION("DBusProxy", "Property cannot be empty");
+            }
+            return start_async_call(property_proxy,
+                                    "org.freedesktop.DBus.Properties.Get",
+                                    "Get",
+                                    g_variant_new("(ss)",
+                                                  interface.c_str(),
+                                                  property.c_str()),
+                                    G_DBUS_CALL_FLAGS_NONE,
+                                    timeout_ms, cb, true);
+        }
+
+
+        /**
+         *  Retrieves all the properties of the D-Bus object in a single
+         *  call to org.freedesktop.DBus.Properties.GetAll().
+         *
+         * @return  Returns a DBusPropertySnapshot with all property values
+         */
+        DBusPropertySnapshot GetAllProperties()
+        {
+            GError *error = NULL;
+            GVariant *response = g_dbus_proxy_call_sync(property_proxy,
+                                                        "GetAll",
+                                                        g_variant_new("(s)",
+                                                                      interface.c_str()),
+                                                        G_DBUS_CALL_FLAGS_NONE,
+                                                        -1,          // timeout, -1 == default
+                                                        NULL,        // GCancellable
+                                                        &error);
+            if (!response || error)
+            {
+                std::stringstream errmsg;
+                errmsg << "Failed calling D-Bus method "
+                       << "org.freedesktop.DBus.Properties.GetAll("
+                       << "interface=" << interface
+                       << ")";
+                if (error)
+                {
+                    errmsg << ": " << error->message;
+                }
+                THROW_DBUSEXCEPTION("DBusProxy", errmsg.str());
+            }
+            GVariant *props = g_variant_get_child_value(response, 0);
+            g_variant_unref(response);
+
+            DBusPropertySnapshot ret(props);
+            g_variant_unref(props);
+            return ret;
+        }
+
+
+        /**
+         *  Asynchronous variant of GetAllProperties().  The result of the
+         *  returned DBusPendingCall is the a{sv} dictionary which can be
+         *  parsed by DBusPropertySnapshot.
+         *
+         * @param timeout_ms  Timeout in milliseconds for this call, -1 for
+         *                    the D-Bus default timeout
+         * @param cb          Optional completion callback function
+         *
+         * @return  Returns a DBusPendingCall::Ptr for this request
+         */
+        DBusPendingCall::Ptr GetAllPropertiesAsync(int timeout_ms = -1,
+                                                   DBusPendingCall::Completed cb = nullptr)
+        {
+            return start_async_call(property_proxy,
+                                    "org.freedesktop.DBus.Properties.GetAll",
+                                    "GetAll",
+                                    g_variant_new("(s)", interface.c_str()),
+                                    G_DBUS_CALL_FLAGS_NONE,
+                                    timeout_ms, cb, true);
+        }
+
+
         bool GetBoolProperty(std::string property)
         {
             GVariant *res = GetProperty(property);
@@ -379,10 +863,6 @@ namespace openvpn
 
         GDBusProxy * SetupProxy(std::string busn, std::string intf, std::string objp)
         {
-            if (busn.empty()) {
-                THROW_DBUSEXCEPTION("DBusProxy", "Bus name cannot be empty");
-            }
-
             if (intf.empty()) {
                 THROW_DBUSEXCEPTION("DBusProxy", "Interface cannot be empty");
             }
@@ -396,6 +876,14 @@ namespace openvpn
             // checks if a connection is already established
             Connect();
 
+            // Only peer-to-peer connections, which have no unique bus
+            // name, can be used without a bus name
+            if (busn.empty()
+                && NULL != g_dbus_connection_get_unique_name(GetConnection()))
+            {
+                THROW_DBUSEXCEPTION("DBusProxy", "Bus name cannot be empty");
+            }
+
             /*
               std::cout << "[DBusProxy::SetupProxy] bus_name=" << busn
                       << ", interface=" << intf
@@ -403,28 +891,12 @@ namespace openvpn
                       << std::endl;
             */
 
-            // Prepare a new D-Bus proxy, which the
-            // client side uses when communicating with
-            // a D-Bus service
-            GError *error = NULL;
-            GDBusProxy *retprx = g_dbus_proxy_new_sync(GetConnection(),
-                                                       G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
-                                                       NULL,             // GDBusInterfaceInfo
-                                                       busn.c_str(),     // aka. destination
-                                                       objp.c_str(),
-                                                       intf.c_str(),
-                                                       NULL,             // GCancellable
-                                                       &error);
-            if (!retprx || error)
-            {
-                std::stringstream errmsg;
-                errmsg << "Failed preparing proxy";
-                if (error)
-                {
-                    errmsg << ": " << error->message;
-                }
-                THROW_DBUSEXCEPTION("DBusProxy", errmsg.str());
-            }
+            // Retrieve a D-Bus proxy, which the client side uses when
+            // communicating with a D-Bus service.  Proxies are shared
+            // through the process wide pool, avoiding the setup cost
+            // for each new DBusProxy object.
+            GDBusProxy *retprx = DBusProxyPool::Get().Acquire(GetConnection(),
+                                                              busn, intf, objp);
             if ("org.freedesktop.DBus.Properties" == intf)
             {
                 property_proxy_init = true;
@@ -443,6 +915,55 @@ namespace openvpn
         }
 
 
+        /**
+         *  Calls a bulk fetch method with the signature
+         *  (in u offset, in u limit, in as fields, out a(oa{sv}) objects)
+         *  and parses the result.
+         *
+         * @param method  std::string with the method name to call
+         * @param offset  Number of accessible objects to skip
+         * @param limit   Maximum number of objects to return, 0 for all
+         * @param fields  Properties to retrieve, empty for the default set
+         *
+         * @return  Returns a DBusPropertySnapshotList with the result
+         */
+        DBusPropertySnapshotList FetchObjectsDetailed(std::string method,
+                                                      guint32 offset,
+                                                      guint32 limit,
+                                                      std::vector<std::string> const & fields)
+        {
+            GVariantBuilder *fl = g_variant_builder_new(G_VARIANT_TYPE("as"));
+            for (auto& f : fields)
+            {
+                g_variant_builder_add(fl, "s", f.c_str());
+            }
+            GVariant *res = Call(method, g_variant_new("(uuas)", offset, limit, fl));
+            g_variant_builder_unref(fl);
+            if (NULL == res)
+            {
+                THROW_DBUSEXCEPTION("DBusProxy",
+                                    "Failed calling D-Bus method " + method);
+            }
+
+            GVariantIter *objs = NULL;
+            g_variant_get(res, "(a(oa{sv}))", &objs);
+
+            DBusPropertySnapshotList ret;
+            gchar *path = NULL;
+            GVariant *props = NULL;
+            while (g_variant_iter_next(objs, "(o@a{sv})", &path, &props))
+            {
+                ret.push_back(std::make_pair(std::string(path),
+                                             DBusPropertySnapshot(props)));
+                g_free(path);
+                g_variant_unref(props);
+            }
+            g_variant_iter_free(objs);
+            g_variant_unref(res);
+            return ret;
+        }
+
+
     private:
         std::string bus_name;
         std::string interface;
@@ -450,6 +971,31 @@ namespace openvpn
         GDBusCallFlags call_flags;
         bool proxy_init;
         bool property_proxy_init;
+
+
+        DBusPendingCall::Ptr start_async_call(GDBusProxy *prx,
+                                              std::string const & descr,
+                                              std::string const & method,
+                                              GVariant *params,
+                                              GDBusCallFlags flags,
+                                              int timeout_ms,
+                                              DBusPendingCall::Completed cb,
+                                              bool unwrap_variant)
+        {
+            DBusPendingCall::Ptr call(new DBusPendingCall(descr, cb,
+                                                          unwrap_variant));
+
+            // The call object must survive until the completion callback
+            // has run, regardless of what the caller does with the
+            // returned pointer.
+            g_dbus_proxy_call(prx, method.c_str(), params,
+                              flags,
+                              timeout_ms,
+                              call->cancellable,
+                              DBusPendingCall::_cb_call_complete,
+                              new DBusPendingCall::Ptr(call));
+            return call;
+        }
     };
 };
 #endif // OPENVPN3_DBUS_PROXY_HPP
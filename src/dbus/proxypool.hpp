@@ -0,0 +1,278 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2018      OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2018      David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   proxypool.hpp
+ *
+ * @brief  Process wide pool of GDBusProxy objects, shared between
+ *         all DBusProxy instances
+ */
+
+#ifndef OPENVPN3_DBUS_PROXYPOOL_HPP
+#define OPENVPN3_DBUS_PROXYPOOL_HPP
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace openvpn
+{
+    /**
+     *  Keeps GDBusProxy objects alive for reuse, keyed by the
+     *  D-Bus connection, bus name, object path and interface.
+     *
+     *  The D-Bus connection itself is already shared per bus type by
+     *  g_bus_get_sync().  But preparing a GDBusProxy requires a
+     *  round-trip to the D-Bus daemon to look up the owner of the bus
+     *  name.  As DBusProxy objects are often short-lived, this setup
+     *  cost easily dominates the cost of the method call itself.
+     *
+     *  Proxies are created on the first Acquire() and are reference
+     *  counted by the pool.  When the last user releases a proxy, it is
+     *  kept in an idle list.  The least recently used idle proxies are
+     *  evicted when the idle list grows beyond its limit.
+     */
+    class DBusProxyPool
+    {
+    public:
+        /**
+         *  Retrieve the process wide pool instance
+         */
+        static DBusProxyPool& Get()
+        {
+            static DBusProxyPool pool;
+            return pool;
+        }
+
+
+        ~DBusProxyPool()
+        {
+            Flush();
+        }
+
+
+        /**
+         *  Retrieve a proxy for a specific D-Bus object and interface.
+         *  If a proxy is not already available, a new one is created.
+         *  Each Acquire() call must be paired with a Release() call.
+         *
+         * @param conn  GDBusConnection the proxy must use
+         * @param busn  std::string with the bus name (destination)
+         * @param intf  std::string with the D-Bus interface
+         * @param objp  std::string with the D-Bus object path
+         *
+         * @return  Returns a GDBusProxy pointer.  The caller holds a
+         *          reference which is released by Release().
+         */
+        GDBusProxy * Acquire(GDBusConnection *conn, std::string const & busn,
+                             std::string const & intf, std::string const & objp)
+        {
+            Key key(conn, busn, objp, intf);
+            {
+                std::lock_guard<std::mutex> guard(mtx);
+                auto it = proxies.find(key);
+                if (proxies.end() != it)
+                {
+                    if (!g_dbus_connection_is_closed(conn))
+                    {
+                        return reuse(it);
+                    }
+                    // Stale proxy on a closed connection; replace it
+                    evict(it);
+                }
+            }
+
+            // Prepare a new D-Bus proxy without holding the lock; this
+            // requires a round-trip to the D-Bus daemon
+            GError *error = NULL;
+            GDBusProxy *prx = g_dbus_proxy_new_sync(conn,
+                                                    G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
+                                                    NULL,             // GDBusInterfaceInfo
+                                                    // Peer-to-peer connections has no bus name
+                                                    (busn.empty() ? NULL : busn.c_str()),
+                                                    objp.c_str(),
+                                                    intf.c_str(),
+                                                    NULL,             // GCancellable
+                                                    &error);
+            if (!prx || error)
+            {
+                std::stringstream errmsg;
+                errmsg << "Failed preparing proxy";
+                if (error)
+                {
+                    errmsg << ": " << error->message;
+                    g_error_free(error);
+                }
+                THROW_DBUSEXCEPTION("DBusProxyPool", errmsg.str());
+            }
+
+            std::lock_guard<std::mutex> guard(mtx);
+            auto it = proxies.find(key);
+            if (proxies.end() != it)
+            {
+                // Another thread prepared the same proxy meanwhile
+                g_object_unref(prx);
+                return reuse(it);
+            }
+
+            Entry e;
+            e.proxy = prx;
+            e.refcount = 1;
+            e.idle = false;
+            proxies[key] = e;
+            lookup[prx] = key;
+            return G_DBUS_PROXY(g_object_ref(prx));
+        }
+
+
+        /**
+         *  Release a proxy retrieved via Acquire().  The proxy will be
+         *  kept in the pool until it is evicted.
+         *
+         * @param prx  GDBusProxy pointer to release
+         */
+        void Release(GDBusProxy *prx) noexcept
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            auto lk = lookup.find(prx);
+            if (lookup.end() != lk)
+            {
+                auto it = proxies.find(lk->second);
+                if (0 < it->second.refcount && 0 == --it->second.refcount)
+                {
+                    idle_list.push_front(it->first);
+                    it->second.idle_pos = idle_list.begin();
+                    it->second.idle = true;
+
+                    while (idle_list.size() > max_idle)
+                    {
+                        evict(proxies.find(idle_list.back()));
+                    }
+                }
+            }
+            // else: already evicted from the pool, only the
+            // caller's reference is left
+
+            g_object_unref(prx);
+        }
+
+
+        /**
+         *  Sets the maximum number of unused proxies kept in the pool
+         *
+         * @param max  Number of idle proxies to keep, 0 disables caching
+         */
+        void SetMaxIdle(size_t max) noexcept
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            max_idle = max;
+            while (idle_list.size() > max_idle)
+            {
+                evict(proxies.find(idle_list.back()));
+            }
+        }
+
+
+        /**
+         *  Evicts all unused proxies from the pool
+         */
+        void Flush() noexcept
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            while (!idle_list.empty())
+            {
+                evict(proxies.find(idle_list.back()));
+            }
+        }
+
+
+        /**
+         *  Evicts all unused proxies tied to a specific D-Bus connection.
+         *  Used before closing private connections, as the pooled proxies
+         *  keeps a reference to the connection.
+         *
+         * @param conn  GDBusConnection to evict the proxies for
+         */
+        void EvictConnection(GDBusConnection *conn) noexcept
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            auto it = idle_list.begin();
+            while (idle_list.end() != it)
+            {
+                auto cur = it++;
+                if (std::get<0>(*cur) == conn)
+                {
+                    evict(proxies.find(*cur));
+                }
+            }
+        }
+
+
+    private:
+        typedef std::tuple<GDBusConnection *,
+                           std::string, std::string, std::string> Key;
+
+        struct Entry
+        {
+            GDBusProxy *proxy;
+            unsigned int refcount;
+            bool idle;
+            std::list<Key>::iterator idle_pos;
+        };
+
+        std::mutex mtx;
+        std::map<Key, Entry> proxies;
+        std::map<GDBusProxy *, Key> lookup;
+        std::list<Key> idle_list;
+        size_t max_idle = 64;
+
+
+        DBusProxyPool()
+        {
+        }
+
+
+        GDBusProxy * reuse(std::map<Key, Entry>::iterator it)
+        {
+            if (it->second.idle)
+            {
+                idle_list.erase(it->second.idle_pos);
+                it->second.idle = false;
+            }
+            it->second.refcount++;
+            return G_DBUS_PROXY(g_object_ref(it->second.proxy));
+        }
+
+
+        void evict(std::map<Key, Entry>::iterator it) noexcept
+        {
+            if (it->second.idle)
+            {
+                idle_list.erase(it->second.idle_pos);
+            }
+            lookup.erase(it->second.proxy);
+            // Users still holding this proxy have their own reference
+            g_object_unref(it->second.proxy);
+            proxies.erase(it);
+        }
+    };
+};
+
+#endif // OPENVPN3_DBUS_PROXYPOOL_HPP
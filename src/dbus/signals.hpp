@@ -20,7 +20,14 @@
 #ifndef OPENVPN3_DBUS_SIGNALS_HPP
 #define OPENVPN3_DBUS_SIGNALS_HPP
 
+#include <condition_variable>
+#include <functional>
 #include <map>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
 
 namespace openvpn
 {
@@ -36,6 +43,333 @@ namespace openvpn
     }
 
 
+    /**
+     *  Connection level dispatcher of D-Bus signals.
+     *
+     *  GDBus calls every subscription matching an incoming signal.  When
+     *  many objects subscribe to the same broadcast signal, each of them
+     *  is called for every signal, even though only one of them is the
+     *  real receiver.  The router instead keeps only a single GDBus
+     *  subscription per (connection, sender, object path, interface,
+     *  signal name) combination and dispatches the signal to the
+     *  registered handlers via a hash table lookup.
+     *
+     *  Routes may additionally be bound to the value of a string argument
+     *  in the signal.  This is used for broadcast signals carrying a
+     *  reference to the receiver, such as the RegistrationRequest token;
+     *  only the handler bound to that value is called.
+     */
+    class DBusSignalRouter
+    {
+    public:
+        typedef std::function<void(GDBusConnection *conn,
+                                   const std::string sender_name,
+                                   const std::string object_path,
+                                   const std::string interface_name,
+                                   const std::string signal_name,
+                                   GVariant *params)> Handler;
+
+
+        /**
+         *  Retrieve the process wide signal router
+         */
+        static DBusSignalRouter& Get()
+        {
+            static DBusSignalRouter router;
+            return router;
+        }
+
+
+        /**
+         *  Register a new signal handler.  An empty string for sender,
+         *  object path, interface or signal name matches all values.
+         *
+         * @param conn     GDBusConnection to subscribe to signals on
+         * @param sender   std::string with the bus name of the sender
+         * @param objpath  std::string with the object path of the sender
+         * @param interf   std::string with the D-Bus interface of the signal
+         * @param signame  std::string with the signal name
+         * @param handler  Handler to call when the signal is received
+         * @param argidx   Index of a string argument in the signal which
+         *                 must match argval.  If negative, all signals
+         *                 are passed to the handler
+         * @param argval   std::string with the value to match when argidx
+         *                 is used
+         *
+         * @return  Returns a route ID, to be used with RemoveRoute()
+         */
+        guint AddRoute(GDBusConnection *conn,
+                       const std::string& sender,
+                       const std::string& objpath,
+                       const std::string& interf,
+                       const std::string& signame,
+                       Handler handler,
+                       int argidx = -1,
+                       const std::string& argval = "")
+        {
+            Key key(conn, sender, objpath, interf, signame);
+
+            std::lock_guard<std::mutex> guard(mtx);
+            Subscription *sub = nullptr;
+            auto it = subscriptions.find(key);
+            if (subscriptions.end() != it)
+            {
+                sub = it->second;
+                if (0 <= argidx && 0 <= sub->argidx && argidx != sub->argidx)
+                {
+                    THROW_DBUSEXCEPTION("DBusSignalRouter",
+                                        "Conflicting argument index for the "
+                                        + signame + " signal routes");
+                }
+            }
+            else
+            {
+                sub = new Subscription();
+                sub->router = this;
+                sub->argidx = -1;
+                sub->signal_id = g_dbus_connection_signal_subscribe(conn,
+                                                                    string2C_char(sender),
+                                                                    string2C_char(interf),
+                                                                    string2C_char(signame),
+                                                                    string2C_char(objpath),
+                                                                    NULL,
+                                                                    G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                    dispatch,
+                                                                    sub,
+                                                                    destroy_subscription);
+                if (0 == sub->signal_id)
+                {
+                    delete sub;
+                    std::stringstream err;
+                    err << "Failed to subscribe to the " << signame << " signal on "
+                        << objpath << " [" << interf << "]";
+                    THROW_DBUSEXCEPTION("DBusSignalRouter", err.str());
+                }
+                subscriptions[key] = sub;
+            }
+
+            guint id = ++last_route_id;
+            if (0 <= argidx)
+            {
+                sub->argidx = argidx;
+                sub->bound[argval][id] = handler;
+            }
+            else
+            {
+                sub->any[id] = handler;
+            }
+            Route r;
+            r.key = key;
+            r.bound = (0 <= argidx);
+            r.argval = argval;
+            r.handler = handler;
+            routes[id] = r;
+            return id;
+        }
+
+
+        /**
+         *  Removes a route added by AddRoute().  When the last route of a
+         *  GDBus subscription is removed, the subscription is removed too.
+         *
+         *  Once this returns, the handler of the route is not called
+         *  again, and no other thread is running it.  A handler may
+         *  remove its own route or other routes; the removed routes are
+         *  skipped for the rest of the signal being dispatched.
+         *
+         * @param route_id  Route ID to remove
+         */
+        void RemoveRoute(guint route_id) noexcept
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            remove_route(route_id);
+
+            // Wait for the handler to complete if another thread is
+            // running it.  A handler removing its own route must not wait
+            // for itself.
+            dispatch_done.wait(lock, [this, route_id]()
+                               {
+                                   auto range = in_flight.equal_range(route_id);
+                                   for (auto it = range.first; it != range.second; ++it)
+                                   {
+                                       if (std::this_thread::get_id() != it->second)
+                                       {
+                                           return false;
+                                       }
+                                   }
+                                   return true;
+                               });
+        }
+
+
+    private:
+        typedef std::tuple<GDBusConnection *, std::string, std::string,
+                           std::string, std::string> Key;
+        typedef std::map<guint, Handler> HandlerList;
+
+        struct Subscription
+        {
+            DBusSignalRouter *router;
+            guint signal_id;
+            int argidx;
+            HandlerList any;
+            std::unordered_map<std::string, HandlerList> bound;
+        };
+
+        struct Route
+        {
+            Key key;
+            bool bound;
+            std::string argval;
+            Handler handler;
+        };
+
+        std::mutex mtx;
+        std::condition_variable dispatch_done;
+        std::map<Key, Subscription *> subscriptions;
+        std::unordered_map<guint, Route> routes;
+        std::multimap<guint, std::thread::id> in_flight;
+        guint last_route_id = 0;
+
+
+        DBusSignalRouter()
+        {
+        }
+
+
+        void remove_route(guint route_id)
+        {
+            auto r = routes.find(route_id);
+            if (routes.end() == r)
+            {
+                return;
+            }
+
+            auto it = subscriptions.find(r->second.key);
+            if (subscriptions.end() != it)
+            {
+                Subscription *sub = it->second;
+                if (r->second.bound)
+                {
+                    auto b = sub->bound.find(r->second.argval);
+                    if (sub->bound.end() != b)
+                    {
+                        b->second.erase(route_id);
+                        if (b->second.empty())
+                        {
+                            sub->bound.erase(b);
+                        }
+                    }
+                }
+                else
+                {
+                    sub->any.erase(route_id);
+                }
+
+                if (sub->any.empty() && sub->bound.empty())
+                {
+                    // The Subscription object is released by GDBus via
+                    // destroy_subscription() once no more callbacks
+                    // can be called
+                    g_dbus_connection_signal_unsubscribe(std::get<0>(it->first),
+                                                         sub->signal_id);
+                    subscriptions.erase(it);
+                }
+            }
+            routes.erase(r);
+        }
+
+
+        static void dispatch(GDBusConnection *conn,
+                             const gchar *sender,
+                             const gchar *obj_path,
+                             const gchar *intf_name,
+                             const gchar *sign_name,
+                             GVariant *params,
+                             gpointer sub_ptr)
+        {
+            Subscription *sub = (Subscription *) sub_ptr;
+            DBusSignalRouter *router = sub->router;
+            std::vector<guint> route_ids;
+            {
+                // Only the route IDs are collected, so the handlers
+                // can add or remove routes while being called
+                std::lock_guard<std::mutex> guard(router->mtx);
+                for (auto& h : sub->any)
+                {
+                    route_ids.push_back(h.first);
+                }
+
+                if (0 <= sub->argidx && !sub->bound.empty()
+                    && g_variant_is_of_type(params, G_VARIANT_TYPE_TUPLE)
+                    && (gsize) sub->argidx < g_variant_n_children(params))
+                {
+                    GVariant *arg = g_variant_get_child_value(params, sub->argidx);
+                    if (g_variant_is_of_type(arg, G_VARIANT_TYPE_STRING))
+                    {
+                        auto b = sub->bound.find(g_variant_get_string(arg, NULL));
+                        if (sub->bound.end() != b)
+                        {
+                            for (auto& h : b->second)
+                            {
+                                route_ids.push_back(h.first);
+                            }
+                        }
+                    }
+                    g_variant_unref(arg);
+                }
+            }
+
+            for (auto id : route_ids)
+            {
+                Handler handler;
+                std::multimap<guint, std::thread::id>::iterator flight;
+                {
+                    // Skip routes removed by the handlers called so far,
+                    // or by other threads
+                    std::lock_guard<std::mutex> guard(router->mtx);
+                    auto r = router->routes.find(id);
+                    if (router->routes.end() == r)
+                    {
+                        continue;
+                    }
+                    handler = r->second.handler;
+                    flight = router->in_flight.emplace(id, std::this_thread::get_id());
+                }
+
+                try
+                {
+                    handler(conn, C_char2string(sender), C_char2string(obj_path),
+                            C_char2string(intf_name), C_char2string(sign_name),
+                            params);
+                }
+                catch (...)
+                {
+                    router->dispatch_completed(flight);
+                    throw;
+                }
+                router->dispatch_completed(flight);
+            }
+        }
+
+
+        void dispatch_completed(std::multimap<guint, std::thread::id>::iterator flight)
+        {
+            {
+                std::lock_guard<std::mutex> guard(mtx);
+                in_flight.erase(flight);
+            }
+            dispatch_done.notify_all();
+        }
+
+
+        static void destroy_subscription(gpointer sub_ptr)
+        {
+            delete (Subscription *) sub_ptr;
+        }
+    };
+
+
     class DBusSignalSubscription
     {
     public:
@@ -134,25 +468,26 @@ namespace openvpn
 
         void Subscribe(std::string busname, std::string objpath, std::string signal_name)
         {
-            guint signal_id = g_dbus_connection_signal_subscribe(conn,
-                                                           string2C_char(busname),
-                                                           string2C_char(interface),
-                                                           string2C_char(signal_name),
-                                                           string2C_char(objpath),
-                                                           NULL,
-                                                           G_DBUS_SIGNAL_FLAGS_NONE,
-                                                           dbusobject_callback_signal_handler,
-                                                           this,
-                                                           NULL );  // destructor
-            if (signal_id < 0)
-            {
-                std::stringstream err;
-                err << "Failed to subscribe to the " << signal_name << "signal on"
-                    << object_path << "[" << interface << "]";
-                THROW_DBUSEXCEPTION("DBusSignalSubscription", err.str());
-            }
-            subscriptions[signal_name] = signal_id;
-            subscribed = true;
+            add_route(busname, objpath, signal_name, -1, "");
+        }
+
+
+        /**
+         *  Subscribe to a signal where a specific string argument must
+         *  match a given value.  Signals with other values in this
+         *  argument are never passed to this object.
+         *
+         * @param busname      std::string with the bus name of the sender
+         * @param objpath      std::string with the object path of the sender
+         * @param signal_name  std::string with the signal name
+         * @param argidx       Index of the signal argument to match
+         * @param argval       std::string with the argument value to match
+         */
+        void Subscribe(std::string busname, std::string objpath,
+                       std::string signal_name,
+                       unsigned int argidx, std::string argval)
+        {
+            add_route(busname, objpath, signal_name, (int) argidx, argval);
         }
 
 
@@ -172,7 +507,7 @@ namespace openvpn
         {
             if (subscriptions[signal_name] > 0)
             {
-                g_dbus_connection_signal_unsubscribe(conn, subscriptions[signal_name]);
+                DBusSignalRouter::Get().RemoveRoute(subscriptions[signal_name]);
                 subscriptions[signal_name] = 0;
             }
         }
@@ -194,7 +529,7 @@ namespace openvpn
             {
                 if (sub.second > 0)
                 {
-                    g_dbus_connection_signal_unsubscribe(conn, sub.second);
+                    DBusSignalRouter::Get().RemoveRoute(sub.second);
                 }
                 subscriptions[sub.first] = 0;
             }
@@ -233,7 +568,37 @@ namespace openvpn
         std::string interface;
         std::string object_path;
         std::map<std::string, guint> subscriptions;
-        bool subscribed;
+        bool subscribed = false;
+
+
+        void add_route(const std::string& busname, const std::string& objpath,
+                       const std::string& signal_name,
+                       int argidx, const std::string& argval)
+        {
+            // Replacing an existing subscription of the same signal
+            Unsubscribe(signal_name);
+
+            DBusSignalRouter::Handler handler =
+                [this](GDBusConnection *c,
+                       const std::string sender_name,
+                       const std::string obj_path,
+                       const std::string interface_name,
+                       const std::string sig_name,
+                       GVariant *params)
+                {
+                    callback_signal_handler(c, sender_name, obj_path,
+                                            interface_name, sig_name, params);
+                };
+            subscriptions[signal_name] = DBusSignalRouter::Get().AddRoute(conn,
+                                                                         busname,
+                                                                         objpath,
+                                                                         interface,
+                                                                         signal_name,
+                                                                         handler,
+                                                                         argidx,
+                                                                         argval);
+            subscribed = true;
+        }
     };
 
 
@@ -0,0 +1,327 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2018      OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2018      David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   subtree.hpp
+ *
+ * @brief  Serves a large number of DBusObjects below a common object path
+ *         through a single D-Bus subtree registration
+ */
+
+#ifndef OPENVPN3_DBUS_SUBTREE_HPP
+#define OPENVPN3_DBUS_SUBTREE_HPP
+
+#include <string>
+#include <vector>
+
+#include "dbus/object.hpp"
+
+namespace openvpn
+{
+    /**
+     *  Registers a D-Bus subtree, serving all direct child nodes of a root
+     *  object path.  Instead of registering each DBusObject on the D-Bus,
+     *  the objects are marked via DBusObject::RegisterSubtreeObject() and
+     *  looked up via callback_subtree_lookup() each time they are
+     *  accessed.  This keeps the D-Bus library from holding registration
+     *  data for each object.
+     *
+     *  The object is looked up again for each method call and property
+     *  access, so an object removed while calls to it are queued is never
+     *  accessed.
+     */
+    class DBusSubtree
+    {
+    public:
+        /**
+         *  Prepares the subtree
+         *
+         * @param root_path  std::string with the object path of the
+         *                   subtree root.  Only the child nodes are served
+         *                   by the subtree.
+         */
+        DBusSubtree(const std::string root_path)
+            : subtree_root(root_path),
+              subtree_id(0)
+        {
+        }
+
+
+        virtual ~DBusSubtree()
+        {
+        }
+
+
+        /**
+         *  Registers the subtree on the D-Bus
+         *
+         * @param conn  GDBusConnection to register the subtree on
+         */
+        void RegisterSubtree(GDBusConnection *conn)
+        {
+            if (subtree_id > 0)
+            {
+                THROW_DBUSEXCEPTION("DBusSubtree", "Subtree is already registered in D-Bus");
+            }
+
+            // Calls to nodes not listed by callback_subtree_enumerate() are
+            // dispatched too.  This avoids enumerating all the objects on
+            // each method call.
+            GError *error = NULL;
+            subtree_id = g_dbus_connection_register_subtree(conn,
+                                                            subtree_root.c_str(),
+                                                            &subtree_vtable,
+                                                            G_DBUS_SUBTREE_FLAGS_DISPATCH_TO_UNENUMERATED_NODES,
+                                                            this,
+                                                            NULL, // destruct function
+                                                            &error);
+            if (subtree_id < 1)
+            {
+                std::stringstream err;
+                err << "RegisterSubtree(" + subtree_root + ") failed: ";
+                err << (error != NULL ? error->message : "(unknown)");
+                if (error)
+                {
+                    g_error_free(error);
+                }
+                THROW_DBUSEXCEPTION("DBusSubtree", err.str());
+            }
+        }
+
+
+        /**
+         *  Removes the subtree from the D-Bus
+         *
+         * @param conn  GDBusConnection the subtree was registered on
+         */
+        void RemoveSubtree(GDBusConnection *conn) noexcept
+        {
+            if (subtree_id > 0)
+            {
+                g_dbus_connection_unregister_subtree(conn, subtree_id);
+                subtree_id = 0;
+            }
+        }
+
+
+    protected:
+        /**
+         *  Lists the node names of all child objects in the subtree.  This
+         *  is only used for D-Bus introspection of the subtree root.
+         *
+         * @param sender  D-Bus bus name of the caller
+         *
+         * @return  Returns a std::vector<std::string> of node names
+         */
+        virtual std::vector<std::string> callback_subtree_enumerate(const std::string sender) = 0;
+
+
+        /**
+         *  Looks up the object serving a child node of the subtree
+         *
+         * @param node  std::string with the node name, which is the last
+         *              element of the object path
+         *
+         * @return  Returns a pointer to the DBusObject, which must have
+         *          been marked via DBusObject::RegisterSubtreeObject().  If
+         *          the node does not exist, nullptr is returned.
+         */
+        virtual DBusObject * callback_subtree_lookup(const std::string node) = 0;
+
+
+    private:
+        std::string subtree_root;
+        guint subtree_id;
+
+        GDBusSubtreeVTable subtree_vtable = {
+            _cb_subtree_enumerate,
+            _cb_subtree_introspect,
+            _cb_subtree_dispatch
+        };
+
+        GDBusInterfaceVTable object_vtable = {
+            _cb_object_method_call,
+            _cb_object_get_property,
+            _cb_object_set_property
+        };
+
+
+        /**
+         *  Looks up the object of a full object path within the subtree
+         */
+        DBusObject * lookup_path(const gchar *obj_path)
+        {
+            std::string path(obj_path);
+            if (path.size() <= subtree_root.size() + 1
+                || 0 != path.compare(0, subtree_root.size() + 1, subtree_root + "/"))
+            {
+                return nullptr;
+            }
+            DBusObject *obj = callback_subtree_lookup(path.substr(subtree_root.size() + 1));
+            return ((obj && obj->registered) ? obj : nullptr);
+        }
+
+
+        static gchar ** _cb_subtree_enumerate(GDBusConnection *conn,
+                                              const gchar *sender,
+                                              const gchar *obj_path,
+                                              gpointer this_ptr)
+        {
+            DBusSubtree *subtree = (DBusSubtree *) this_ptr;
+            std::vector<std::string> nodes;
+            nodes = subtree->callback_subtree_enumerate(std::string(sender ? sender : ""));
+
+            gchar **ret = g_new0(gchar *, nodes.size() + 1);
+            for (size_t i = 0; i < nodes.size(); i++)
+            {
+                ret[i] = g_strdup(nodes[i].c_str());
+            }
+            return ret;
+        }
+
+
+        static GDBusInterfaceInfo ** _cb_subtree_introspect(GDBusConnection *conn,
+                                                            const gchar *sender,
+                                                            const gchar *obj_path,
+                                                            const gchar *node,
+                                                            gpointer this_ptr)
+        {
+            DBusSubtree *subtree = (DBusSubtree *) this_ptr;
+            if (NULL == node)
+            {
+                // The subtree root is served by a regular DBusObject
+                return NULL;
+            }
+
+            DBusObject *obj = subtree->callback_subtree_lookup(std::string(node));
+            if (nullptr == obj || !obj->registered)
+            {
+                return NULL;
+            }
+
+            // GDBus releases both the array and the references
+            GDBusInterfaceInfo **ret = g_new0(GDBusInterfaceInfo *, 2);
+            ret[0] = g_dbus_interface_info_ref(obj->introspection->interfaces[0]);
+            return ret;
+        }
+
+
+        static const GDBusInterfaceVTable * _cb_subtree_dispatch(GDBusConnection *conn,
+                                                                 const gchar *sender,
+                                                                 const gchar *obj_path,
+                                                                 const gchar *intf_name,
+                                                                 const gchar *node,
+                                                                 gpointer *out_user_data,
+                                                                 gpointer this_ptr)
+        {
+            DBusSubtree *subtree = (DBusSubtree *) this_ptr;
+            if (NULL == node)
+            {
+                return NULL;
+            }
+
+            DBusObject *obj = subtree->callback_subtree_lookup(std::string(node));
+            if (nullptr == obj || !obj->registered)
+            {
+                return NULL;
+            }
+
+            // The object itself is not passed on, as it might be removed
+            // before the call is processed.  It is looked up again.
+            *out_user_data = subtree;
+            return &subtree->object_vtable;
+        }
+
+
+        static void _cb_object_method_call(GDBusConnection *conn,
+                                           const gchar *sender,
+                                           const gchar *obj_path,
+                                           const gchar *intf_name,
+                                           const gchar *meth_name,
+                                           GVariant *params,
+                                           GDBusMethodInvocation *invoc,
+                                           gpointer this_ptr)
+        {
+            DBusSubtree *subtree = (DBusSubtree *) this_ptr;
+            DBusObject *obj = subtree->lookup_path(obj_path);
+            if (nullptr == obj)
+            {
+                g_dbus_method_invocation_return_dbus_error(invoc,
+                                                           "org.freedesktop.DBus.Error.UnknownObject",
+                                                           "Object was removed");
+                return;
+            }
+            DBusObject::dbusobject_callback_method_call(conn, sender, obj_path,
+                                                        intf_name, meth_name,
+                                                        params, invoc, obj);
+        }
+
+
+        static GVariant * _cb_object_get_property(GDBusConnection *conn,
+                                                  const gchar *sender,
+                                                  const gchar *obj_path,
+                                                  const gchar *intf_name,
+                                                  const gchar *property_name,
+                                                  GError **error,
+                                                  gpointer this_ptr)
+        {
+            DBusSubtree *subtree = (DBusSubtree *) this_ptr;
+            DBusObject *obj = subtree->lookup_path(obj_path);
+            if (nullptr == obj)
+            {
+                g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                            "Object was removed");
+                return NULL;
+            }
+            return DBusObject::dbusobject_callback_get_property(conn, sender,
+                                                                obj_path,
+                                                                intf_name,
+                                                                property_name,
+                                                                error, obj);
+        }
+
+
+        static gboolean _cb_object_set_property(GDBusConnection *conn,
+                                                const gchar *sender,
+                                                const gchar *obj_path,
+                                                const gchar *intf_name,
+                                                const gchar *property_name,
+                                                GVariant *value,
+                                                GError **error,
+                                                gpointer this_ptr)
+        {
+            DBusSubtree *subtree = (DBusSubtree *) this_ptr;
+            DBusObject *obj = subtree->lookup_path(obj_path);
+            if (nullptr == obj)
+            {
+                g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                            "Object was removed");
+                return FALSE;
+            }
+            return DBusObject::dbusobject_callback_set_property(conn, sender,
+                                                                obj_path,
+                                                                intf_name,
+                                                                property_name,
+                                                                value, error,
+                                                                obj);
+        }
+    };
+};
+
+#endif // OPENVPN3_DBUS_SUBTREE_HPP
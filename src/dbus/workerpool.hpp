@@ -0,0 +1,327 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2018      OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2018      David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   workerpool.hpp
+ *
+ * @brief  Pool of worker threads running D-Bus method handlers outside
+ *         of the GLib main loop
+ */
+
+#ifndef OPENVPN3_DBUS_WORKERPOOL_HPP
+#define OPENVPN3_DBUS_WORKERPOOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <openvpn/common/rc.hpp>
+
+namespace openvpn
+{
+    /**
+     *  Runs tasks in a fixed set of worker threads.  Tasks are queued on
+     *  strands.  Tasks on the same strand are run one at a time, in the
+     *  order they were queued, while tasks on different strands are run
+     *  in parallel.  This is used to serialize all work on a single
+     *  D-Bus object while different objects are served in parallel.
+     */
+    class DBusWorkerPool : public RC<thread_safe_refcount>
+    {
+    public:
+        typedef RCPtr<DBusWorkerPool> Ptr;
+
+        /**
+         *  A unit of work.  If the strand is closed before the task is
+         *  run, the cancel function is called instead of run.
+         */
+        struct Task
+        {
+            std::function<void()> run;
+            std::function<void()> cancel;
+        };
+
+
+        class Strand
+        {
+            friend class DBusWorkerPool;
+
+            std::deque<Task> tasks;
+            std::vector<std::function<void()>> idle_callbacks;
+            bool scheduled = false;
+            bool running = false;
+            bool closed = false;
+        };
+        typedef std::shared_ptr<Strand> StrandPtr;
+
+
+        /**
+         *  Starts the worker threads
+         *
+         * @param threads  Number of worker threads to start
+         */
+        DBusWorkerPool(unsigned int threads)
+            : stop(false)
+        {
+            for (unsigned int i = 0; i < (threads > 0 ? threads : 1); i++)
+            {
+                workers.push_back(std::thread([this]()
+                                  {
+                                      worker_loop();
+                                  }));
+            }
+        }
+
+
+        ~DBusWorkerPool()
+        {
+            Shutdown();
+        }
+
+
+        /**
+         *  Creates a new strand, used to serialize tasks
+         *
+         * @return  Returns a StrandPtr to the new strand
+         */
+        StrandPtr NewStrand()
+        {
+            return StrandPtr(new Strand());
+        }
+
+
+        /**
+         *  Queues a task on a strand
+         *
+         * @param strand  StrandPtr to the strand to queue the task on
+         * @param task    Task to queue
+         *
+         * @return  Returns false if the strand is closed or the pool is
+         *          stopping.  The task is then not queued.
+         */
+        bool Post(StrandPtr strand, Task task)
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            if (stop || strand->closed)
+            {
+                return false;
+            }
+            strand->tasks.push_back(task);
+            if (!strand->scheduled)
+            {
+                strand->scheduled = true;
+                ready.push_back(strand);
+                cv.notify_one();
+            }
+            return true;
+        }
+
+
+        /**
+         *  Closes a strand.  No more tasks can be queued on the strand,
+         *  and the cancel function of all the queued tasks is called.  A
+         *  task already running is not interrupted.
+         *
+         * @param strand  StrandPtr to the strand to close
+         */
+        void Close(StrandPtr strand)
+        {
+            std::deque<Task> cancelled;
+            {
+                std::lock_guard<std::mutex> guard(mtx);
+                strand->closed = true;
+                cancelled.swap(strand->tasks);
+            }
+            for (auto& t : cancelled)
+            {
+                if (t.cancel)
+                {
+                    t.cancel();
+                }
+            }
+        }
+
+
+        /**
+         *  Checks if a strand has a task running or queued
+         *
+         * @param strand  StrandPtr to the strand to check
+         *
+         * @return  Returns true if the strand is busy
+         */
+        bool IsBusy(StrandPtr strand)
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            return strand->running || !strand->tasks.empty();
+        }
+
+
+        /**
+         *  Calls a function once a strand has no task running or queued.
+         *  If the strand is idle already, the function is called
+         *  immediately by the calling thread.  Otherwise it is called by
+         *  the worker thread completing the last task of the strand.
+         *
+         * @param strand    StrandPtr to the strand to wait for
+         * @param callback  std::function to call when the strand is idle
+         */
+        void WhenIdle(StrandPtr strand, std::function<void()> callback)
+        {
+            {
+                std::lock_guard<std::mutex> guard(mtx);
+                if (strand->scheduled || strand->running)
+                {
+                    strand->idle_callbacks.push_back(callback);
+                    return;
+                }
+            }
+            callback();
+        }
+
+
+        /**
+         *  Stops all worker threads.  Tasks already queued are run
+         *  before the threads stop.
+         */
+        void Shutdown()
+        {
+            {
+                std::lock_guard<std::mutex> guard(mtx);
+                if (stop)
+                {
+                    return;
+                }
+                stop = true;
+            }
+            cv.notify_all();
+            for (auto& w : workers)
+            {
+                if (w.joinable())
+                {
+                    w.join();
+                }
+            }
+        }
+
+
+    private:
+        std::mutex mtx;
+        std::condition_variable cv;
+        bool stop;
+        std::deque<StrandPtr> ready;
+        std::vector<std::thread> workers;
+
+
+        void worker_loop()
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            for (;;)
+            {
+                cv.wait(lock, [this]{ return stop || !ready.empty(); });
+                if (ready.empty())
+                {
+                    // stop is set and all work is done
+                    return;
+                }
+
+                StrandPtr strand = ready.front();
+                ready.pop_front();
+                if (strand->tasks.empty())
+                {
+                    // The strand was closed meanwhile
+                    strand->scheduled = false;
+                    run_idle_callbacks(strand, lock);
+                    continue;
+                }
+                Task task = strand->tasks.front();
+                strand->tasks.pop_front();
+                strand->running = true;
+
+                lock.unlock();
+                try
+                {
+                    task.run();
+                }
+                catch (std::exception& excp)
+                {
+                    // Errors must be handled by the task itself; a
+                    // worker thread must never die
+                    std::cerr << "DBusWorkerPool: Unhandled error in task: "
+                              << excp.what() << std::endl;
+                }
+                catch (...)
+                {
+                    std::cerr << "DBusWorkerPool: Unhandled unknown error in task"
+                              << std::endl;
+                }
+                lock.lock();
+
+                strand->running = false;
+                if (!strand->tasks.empty())
+                {
+                    ready.push_back(strand);
+                    cv.notify_one();
+                }
+                else
+                {
+                    strand->scheduled = false;
+                    run_idle_callbacks(strand, lock);
+                }
+            }
+        }
+
+
+        /**
+         *  Calls the functions waiting for a strand to become idle.  The
+         *  lock is released while the functions are called.
+         */
+        void run_idle_callbacks(StrandPtr strand,
+                                std::unique_lock<std::mutex>& lock)
+        {
+            if (strand->idle_callbacks.empty())
+            {
+                return;
+            }
+            std::vector<std::function<void()>> callbacks;
+            callbacks.swap(strand->idle_callbacks);
+            lock.unlock();
+            for (auto& cb : callbacks)
+            {
+                try
+                {
+                    cb();
+                }
+                catch (std::exception& excp)
+                {
+                    std::cerr << "DBusWorkerPool: Unhandled error in idle callback: "
+                              << excp.what() << std::endl;
+                }
+            }
+            lock.lock();
+        }
+    };
+};
+
+#endif // OPENVPN3_DBUS_WORKERPOOL_HPP
@@ -175,14 +175,48 @@ static int cmd_configs_list(ParsedArgs args)
               << std::endl;
     std::cout << std::setw(32+26+18+2) << std::setfill('-') << "-" << std::endl;
 
+    // Retrieve the needed properties of all profiles in a single call
     bool first = true;
-    for (auto& cfg : confmgr.FetchAvailableConfigs())
+    for (auto& item : confmgr.FetchAvailableConfigsDetailed(0, 0,
+                                                            {"name", "alias", "owner",
+                                                             "import_timestamp",
+                                                             "last_used_timestamp",
+                                                             "used_count"}))
     {
-        if (cfg.empty())
+        std::string& cfg = item.first;
+        DBusPropertySnapshot& cprx = item.second;
+
+        std::string name;
+        std::string alias;
+        std::string user;
+        std::string imported;
+        std::string last_used;
+        unsigned int used_count = 0;
+        try
+        {
+            name = cprx.GetStringProperty("name");
+            alias = cprx.GetStringProperty("alias");
+            user = lookup_username(cprx.GetUIntProperty("owner"));
+
+            std::time_t imp_tstamp = cprx.GetUInt64Property("import_timestamp");
+            imported = std::asctime(std::localtime(&imp_tstamp));
+            imported.erase(imported.find_last_not_of(" \n")+1); // rtrim
+
+            std::time_t last_u_tstamp = cprx.GetUInt64Property("last_used_timestamp");
+            if (last_u_tstamp > 0)
+            {
+                last_used = std::asctime(std::localtime(&last_u_tstamp));
+                last_used.erase(last_used.find_last_not_of(" \n")+1);  // rtrim
+            }
+            used_count = cprx.GetUIntProperty("used_count");
+        }
+        catch (DBusException& excp)
         {
+            // The configuration manager leaves out properties it could
+            // not retrieve; skip such profiles instead of aborting the
+            // whole listing
             continue;
         }
-        OpenVPN3ConfigurationProxy cprx(G_BUS_TYPE_SYSTEM, cfg);
 
         if (!first)
         {
@@ -190,23 +224,6 @@ static int cmd_configs_list(ParsedArgs args)
         }
         first = false;
 
-        std::string name = cprx.GetStringProperty("name");
-        std::string alias = cprx.GetStringProperty("alias");
-        std::string user = lookup_username(cprx.GetUIntProperty("owner"));
-
-        std::time_t imp_tstamp = cprx.GetUInt64Property("import_timestamp");
-        std::string imported(std::asctime(std::localtime(&imp_tstamp)));
-        imported.erase(imported.find_last_not_of(" \n")+1); // rtrim
-
-        std::time_t last_u_tstamp = cprx.GetUInt64Property("last_used_timestamp");
-        std::string last_used;
-        if (last_u_tstamp > 0)
-        {
-            last_used = std::asctime(std::localtime(&last_u_tstamp));
-            last_used.erase(last_used.find_last_not_of(" \n")+1);  // rtrim
-        }
-        unsigned int used_count = cprx.GetUIntProperty("used_count");
-
         std::cout << cfg << std::endl;
         std::cout << imported << std::setw(32 - imported.size()) << std::setfill(' ') << " "
                   << last_used <<  std::setw(26 - last_used.size()) << " "
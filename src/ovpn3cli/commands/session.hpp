@@ -23,6 +23,9 @@
  * @brief  Commands to start and manage VPN sessions
  */
 
+#include <algorithm>
+#include <deque>
+
 #include <json/json.h>
 
 #include "common/cmdargparser.hpp"
@@ -132,13 +135,299 @@ static int cmd_session_stats(ParsedArgs args)
 }
 
 
+/**
+ *  Looks up the name of a status code received over the D-Bus.  Unknown
+ *  codes are not trusted to be within the table.
+ *
+ * @param table  StatusMajor_str or StatusMinor_str
+ * @param code   Status code to look up
+ *
+ * @return Returns the name of the status code, or the numeric value if
+ *         the code is unknown
+ */
+template <size_t N>
+static std::string status_code_str(const std::array<const std::string, N>& table,
+                                   guint32 code)
+{
+    if (code < table.size())
+    {
+        return table[code];
+    }
+    return "(" + std::to_string(code) + ")";
+}
+
+
+/**
+ *  Tracks the StatusChange and AttentionRequired signals of a single
+ *  session while it is being started.  Signals are queued as they arrive
+ *  and processed one by one via WaitForEvent() and NextEvent().
+ */
+class SessionStartWatcher : public DBusSignalSubscription
+{
+public:
+    /**
+     *  A single StatusChange or AttentionRequired signal
+     */
+    struct Event
+    {
+        bool attention;
+        BackendStatus status;
+    };
+
+
+    /**
+     *  Subscribes to the signals of a session.  This must be done before
+     *  calling any methods on the session, to not miss any signals.
+     *
+     * @param dbuscon       D-Bus connection to use for subscribing
+     * @param session_path  std::string with the D-Bus path to the session
+     */
+    SessionStartWatcher(GDBusConnection *dbuscon,
+                        const std::string session_path)
+        : DBusSignalSubscription(dbuscon, OpenVPN3DBus_name_sessions,
+                                 OpenVPN3DBus_interf_sessions,
+                                 session_path),
+          main_loop(g_main_loop_new(NULL, FALSE))
+    {
+        Subscribe("StatusChange");
+        Subscribe("AttentionRequired");
+    }
+
+
+    ~SessionStartWatcher()
+    {
+        Cleanup();
+        g_main_loop_unref(main_loop);
+    }
+
+
+    void callback_signal_handler(GDBusConnection *connection,
+                                 const std::string sender_name,
+                                 const std::string object_path,
+                                 const std::string interface_name,
+                                 const std::string signal_name,
+                                 GVariant *parameters)
+    {
+        Event ev;
+        if ("StatusChange" == signal_name)
+        {
+            guint32 major = 0;
+            guint32 minor = 0;
+            gchar *msg = nullptr;
+            g_variant_get(parameters, "(uus)", &major, &minor, &msg);
+            ev.attention = false;
+            ev.status.major = (StatusMajor) major;
+            ev.status.major_str = status_code_str(StatusMajor_str, major);
+            ev.status.minor = (StatusMinor) minor;
+            ev.status.minor_str = status_code_str(StatusMinor_str, minor);
+            ev.status.message = std::string(msg);
+            g_free(msg);
+        }
+        else if ("AttentionRequired" == signal_name)
+        {
+            ev.attention = true;
+        }
+        else
+        {
+            return;
+        }
+        events.push_back(ev);
+        g_main_loop_quit(main_loop);
+    }
+
+
+    /**
+     *  Waits until a signal has been received or the deadline passes
+     *
+     * @param deadline  Monotonic time, in microseconds, when to give up
+     *
+     * @return  Returns true if a signal is available via NextEvent(),
+     *          otherwise false if the deadline passed.
+     */
+    bool WaitForEvent(gint64 deadline)
+    {
+        while (events.empty())
+        {
+            gint64 now = g_get_monotonic_time();
+            if (now >= deadline)
+            {
+                return false;
+            }
+
+            GSource *timer = g_timeout_source_new((deadline - now) / 1000 + 1);
+            g_source_set_callback(timer, _cb_timeout, main_loop, NULL);
+            g_source_attach(timer, NULL);
+            g_main_loop_run(main_loop);
+            g_source_destroy(timer);
+            g_source_unref(timer);
+        }
+        return true;
+    }
+
+
+    /**
+     *  Discards all AttentionRequired signals received so far, including
+     *  signals already received but not yet dispatched.  Status changes
+     *  are kept.  This is used before calling Connect, so only requests
+     *  for user input sent after that call are acted upon.
+     */
+    void DiscardAttention()
+    {
+        while (g_main_context_iteration(NULL, FALSE))
+        {
+            // Dispatch everything already received
+        }
+        events.erase(std::remove_if(events.begin(), events.end(),
+                                    [](const Event& ev)
+                                    {
+                                        return ev.attention;
+                                    }),
+                     events.end());
+    }
+
+
+    /**
+     *  Retrieve the oldest signal received.  WaitForEvent() must have
+     *  returned true before calling this method.
+     */
+    Event NextEvent()
+    {
+        Event ev = events.front();
+        events.pop_front();
+        return ev;
+    }
+
+
+private:
+    GMainLoop *main_loop;
+    std::deque<Event> events;
+
+
+    static gboolean _cb_timeout(gpointer loop)
+    {
+        g_main_loop_quit((GMainLoop *) loop);
+        return G_SOURCE_REMOVE;
+    }
+};
+
+
+/**
+ *  Asks the user for all the credentials the VPN backend of a session
+ *  is waiting for.
+ *
+ * @param session  OpenVPN3SessionProxy to the session needing credentials
+ */
+static void query_session_credentials(OpenVPN3SessionProxy& session)
+{
+    for (auto& type_group : session.QueueCheckTypeGroup())
+    {
+        ClientAttentionType type;
+        ClientAttentionGroup group;
+        std::tie(type, group) = type_group;
+
+        if (ClientAttentionType::CREDENTIALS == type)
+        {
+            std::vector<struct RequiresSlot> reqslots;
+            session.QueueFetchAll(reqslots, type, group);
+            for (auto& r : reqslots)
+            {
+                std::string response;
+                if (!r.hidden_input)
+                {
+                    std::cout << r.user_description << ": ";
+                    std::cin >> response;
+                }
+                else
+                {
+                    std::string prompt = r.user_description + ": ";
+                    char *pass = getpass(prompt.c_str());
+                    response = std::string(pass);
+                }
+                r.value = response;
+                session.ProvideResponse(r);
+            }
+        }
+    }
+}
+
+
+/**
+ *  Prints the reason a session failed to start and shuts the session down
+ *
+ * @param session  OpenVPN3SessionProxy to the failed session
+ * @param s        BackendStatus with the last status of the session
+ *
+ * @return Returns the exit code which will be returned to the calling shell
+ */
+static int session_start_failed(OpenVPN3SessionProxy& session,
+                                const BackendStatus& s)
+{
+    std::cout << "Failed to connect "
+              << "[" << status_code_str(StatusMajor_str, (guint32) s.major)
+              << " / " << status_code_str(StatusMinor_str, (guint32) s.minor)
+              << "]" << std::endl;
+    if (!s.message.empty())
+    {
+        std::cout << s.message << std::endl;
+    }
+
+    try
+    {
+        session.Disconnect();
+    }
+    catch (DBusException&)
+    {
+        // The session manager may already have removed the session
+    }
+    return 3;
+}
+
+
+/**
+ *  Resolves the --config argument of session-start.  If it is not an
+ *  existing file, it is looked up as the name or alias of an already
+ *  imported configuration profile.  Otherwise the file is imported as a
+ *  single-use configuration.
+ *
+ * @param config  std::string with the --config argument
+ *
+ * @return Returns the D-Bus object path of the configuration profile
+ */
+static std::string resolve_session_config(const std::string config)
+{
+    if (g_file_test(config.c_str(), G_FILE_TEST_EXISTS))
+    {
+        return import_config(config, config, true, false);
+    }
+
+    OpenVPN3ConfigurationProxy cfgmgr(G_BUS_TYPE_SYSTEM,
+                                      OpenVPN3DBus_rootp_configuration);
+    std::vector<std::string> paths = cfgmgr.LookupConfigName(config);
+    if (paths.empty())
+    {
+        throw CommandException("session-start",
+                               "No configuration file or profile named '"
+                               + config + "' found");
+    }
+    if (paths.size() > 1)
+    {
+        throw CommandException("session-start",
+                               "More than one configuration profile named '"
+                               + config + "' found, use --config-path");
+    }
+    return paths[0];
+}
+
+
 /**
  *  openvpn3 session-start command
  *
- *  This command is used to initate and start a new VPN session
+ *  This command is used to initate and start a new VPN session.  The
+ *  progress is tracked via the StatusChange and AttentionRequired signals
+ *  of the session.
  *
- * @param args
- * @return
+ * @param args  ParsedArgs object containing all related options and arguments
+ * @return Returns the exit code which will be returned to the calling shell
  */
 static int cmd_session_start(ParsedArgs args)
 {
@@ -153,6 +442,20 @@ static int cmd_session_start(ParsedArgs args)
                                "--config and --config-path cannot be used together");
     }
 
+    unsigned int timeout = 30;
+    if (args.Present("timeout"))
+    {
+        try
+        {
+            timeout = std::stoul(args.GetValue("timeout", 0));
+        }
+        catch (std::exception&)
+        {
+            throw CommandException("session-start",
+                                   "Invalid --timeout value");
+        }
+    }
+
     try
     {
         OpenVPN3SessionProxy sessmgr(G_BUS_TYPE_SYSTEM,
@@ -161,102 +464,82 @@ static int cmd_session_start(ParsedArgs args)
         std::string cfgpath;
         if (args.Present("config"))
         {
-            cfgpath = import_config(args.GetValue("config", 0),
-                                    args.GetValue("config", 0),
-                                    true, false);
+            cfgpath = resolve_session_config(args.GetValue("config", 0));
         }
         else
         {
             cfgpath = args.GetValue("config-path", 0);
         }
 
+        DBus dbuscon(G_BUS_TYPE_SYSTEM);
+        dbuscon.Connect();
+        gint64 deadline = g_get_monotonic_time()
+                          + (gint64) timeout * G_USEC_PER_SEC;
 
         std::string sessionpath = sessmgr.NewTunnel(cfgpath);
-
-        sleep(1);  // Allow session to be established (FIXME: Signals?)
+        SessionStartWatcher watcher(dbuscon.GetConnection(), sessionpath);
         std::cout << "Session path: " << sessionpath << std::endl;
         OpenVPN3SessionProxy session(G_BUS_TYPE_SYSTEM, sessionpath);
 
+        // Wait for the VPN backend to register with the session manager.
+        // If a status is already available, the signals announcing the
+        // registration were sent before the watcher was ready.
+        BackendStatus s;
+        bool backend_ready = false;
+        try
+        {
+            s = session.GetLastStatus();
+            backend_ready = true;
+        }
+        catch (DBusException&)
+        {
+            // No status available yet
+        }
+        while (!backend_ready)
+        {
+            if (!watcher.WaitForEvent(deadline))
+            {
+                std::cout << "Timed out waiting for the VPN backend to start"
+                          << std::endl;
+                return session_start_failed(session, s);
+            }
+
+            SessionStartWatcher::Event ev = watcher.NextEvent();
+            if (ev.attention)
+            {
+                backend_ready = true;
+                continue;
+            }
+            s = ev.status;
+            if (StatusMajor::SESSION == s.major
+                && (StatusMinor::PROC_KILLED == s.minor
+                    || StatusMinor::PROC_STOPPED == s.minor))
+            {
+                return session_start_failed(session, s);
+            }
+            backend_ready = (StatusMinor::SESS_NEW == s.minor
+                             || StatusMajor::CONNECTION == s.major);
+        }
+
         unsigned int loops = 10;
         while (loops > 0)
         {
             loops--;
             try
             {
+                // Requests for user input received until now are either
+                // handled by Ready() or are duplicates.  They must not
+                // trigger another Connect call while connecting.
+                watcher.DiscardAttention();
                 session.Ready();  // If not, an exception will be thrown
                 session.Connect();
-
-                // Allow approx 30 seconds to establish connection; one loop
-                // will take about 1.3 seconds.
-                unsigned int attempts = 23;
-                BackendStatus s;
-                while (attempts > 0)
-                {
-                    attempts--;
-                    usleep(300000);  // sleep 0.3 seconds - avg setup time
-                    s = session.GetLastStatus();
-                    if (s.minor == StatusMinor::CONN_CONNECTED)
-                    {
-                        std::cout << "Connected" << std::endl;
-                        return 0;
-                    }
-                    else if (s.minor == StatusMinor::CONN_DISCONNECTED)
-                    {
-                        attempts = 0;
-                        break;
-                    }
-                    sleep(1);  // If not yet connected, wait for 1 second
-                }
-
-                if (attempts < 1)
-                {
-                    // FIXME: Look into using exceptions here, catch more
-                    // fine grained connection issues from the backend
-                    std::cout << "Failed to connect "
-                              << "[" << StatusMajor_str[(unsigned int)s.major]
-                              << " / " << StatusMinor_str[(unsigned int)s.minor]
-                              << "]" << std::endl;
-                    if (!s.message.empty())
-                    {
-                        std::cout << s.message << std::endl;
-                    }
-                    session.Disconnect();
-                    return 3;
-                }
             }
             catch (ReadyException& err)
             {
                 // If the ReadyException is thrown, it means the backend
                 // needs more from the front-end side
-                for (auto& type_group : session.QueueCheckTypeGroup())
-                {
-                    ClientAttentionType type;
-                    ClientAttentionGroup group;
-                    std::tie(type, group) = type_group;
-
-                    if (ClientAttentionType::CREDENTIALS == type)
-                    {
-                        std::vector<struct RequiresSlot> reqslots;
-                        session.QueueFetchAll(reqslots, type, group);
-                        for (auto& r : reqslots)
-                        {
-                            std::string response;
-                            if (!r.hidden_input)
-                            {
-                                std::cout << r.user_description << ": ";
-                                std::cin >> response;
-                            }
-                            else
-                            {
-                                std::string prompt = r.user_description + ": ";
-                                char *pass = getpass(prompt.c_str());
-                                response = std::string(pass);
-                            }
-                            r.value = response;
-                            session.ProvideResponse(r);
-                        }
-                    }
-                }
+                query_session_credentials(session);
+                continue;
             }
             catch (DBusException& err)
             {
@@ -265,9 +548,60 @@ static int cmd_session_start(ParsedArgs args)
                      << err.getRawError();
                 throw CommandException("session-start", errm.str());
             }
+
+            // Wait for the outcome of the connection attempt
+            for (;;)
+            {
+                if (!watcher.WaitForEvent(deadline))
+                {
+                    std::cout << "Timed out waiting for the connection"
+                              << std::endl;
+                    return session_start_failed(session, s);
+                }
+
+                SessionStartWatcher::Event ev = watcher.NextEvent();
+                if (ev.attention)
+                {
+                    // Only restart the connection if the backend still
+                    // waits for user input; duplicated requests which
+                    // have already been answered are ignored.
+                    try
+                    {
+                        session.Ready();
+                        continue;
+                    }
+                    catch (ReadyException&)
+                    {
+                        // The backend needs more user input before it
+                        // can continue
+                        break;
+                    }
+                }
+
+                s = ev.status;
+                switch (s.minor)
+                {
+                case StatusMinor::CONN_CONNECTED:
+                    std::cout << "Connected" << std::endl;
+                    return 0;
+
+                case StatusMinor::CONN_DISCONNECTED:
+                case StatusMinor::CONN_FAILED:
+                case StatusMinor::CONN_AUTH_FAILED:
+                case StatusMinor::CFG_ERROR:
+                case StatusMinor::PROC_STOPPED:
+                case StatusMinor::PROC_KILLED:
+                    return session_start_failed(session, s);
+
+                default:
+                    // Intermediate status, keep waiting
+                    break;
+                }
+            }
         }
 
-        return 0;
+        // The backend kept asking for more user input
+        return session_start_failed(session, s);
     }
     catch (...)
     {
@@ -292,14 +626,57 @@ static int cmd_session_list(ParsedArgs args)
     OpenVPN3SessionProxy sessmgr(G_BUS_TYPE_SYSTEM,
                                  OpenVPN3DBus_rootp_sessions);
 
+    // Retrieve the needed properties of all sessions in a single call
+    DBusPropertySnapshotList sessions =
+        sessmgr.FetchAvailableSessionsDetailed(0, 0,
+                                               {"owner", "backend_pid",
+                                                "session_created",
+                                                "status", "config_path"});
+
+    // Look up the configuration profile names, with all the requests
+    // issued at once before waiting for the responses
+    std::vector<std::unique_ptr<OpenVPN3ConfigurationProxy>> cfgproxies;
+    std::vector<DBusPendingCall::Ptr> cfgnames;
+    for (auto& s : sessions)
+    {
+        DBusPendingCall::Ptr cfgname;
+        try
+        {
+            std::string config_path = s.second.GetStringProperty("config_path");
+            cfgproxies.push_back(std::unique_ptr<OpenVPN3ConfigurationProxy>(
+                                     new OpenVPN3ConfigurationProxy(G_BUS_TYPE_SYSTEM,
+                                                                    config_path)));
+            cfgname = cfgproxies.back()->GetPropertyAsync("name");
+        }
+        catch (...)
+        {
+            // Failure is okay here, the profile may be deleted.
+        }
+        cfgnames.push_back(cfgname);
+    }
+
     bool first = true;
-    for (auto& sessp : sessmgr.FetchAvailableSessions())
+    for (unsigned int i = 0; i < sessions.size(); i++)
     {
-        if (sessp.empty())
+        std::string& sessp = sessions[i].first;
+        DBusPropertySnapshot& sprx = sessions[i].second;
+
+        std::string owner;
+        pid_t be_pid = 0;
+        std::time_t sess_created = 0;
+        try
+        {
+            owner = lookup_username(sprx.GetUIntProperty("owner"));
+            be_pid = sprx.GetUIntProperty("backend_pid");
+            sess_created = sprx.GetUInt64Property("session_created");
+        }
+        catch (DBusException& excp)
         {
+            // The session manager leaves out properties it could not
+            // retrieve, such as for a session being removed; skip such
+            // sessions instead of aborting the whole listing
             continue;
         }
-        OpenVPN3SessionProxy sprx(G_BUS_TYPE_SYSTEM, sessp);
 
         if (first)
         {
@@ -311,28 +688,23 @@ static int cmd_session_list(ParsedArgs args)
         }
         first = false;
 
-        std::string owner = lookup_username(sprx.GetUIntProperty("owner"));
-        pid_t be_pid = sprx.GetUIntProperty("backend_pid");
-
         std::string status_str;
         BackendStatus status;
         std::string cfgname = "";
         try
         {
-            status = sprx.GetLastStatus();
+            GVariant *v = sprx.Get("status");
+            status.Parse(v);
+            g_variant_unref(v);
             status_str = "[" + std::to_string((unsigned int) status.major) + ","
                             + std::to_string((unsigned int) status.minor) + "] "
                             + status.major_str + ", " + status.minor_str;
 
-            std::string config_path = sprx.GetStringProperty("config_path");
-            try
-            {
-                OpenVPN3ConfigurationProxy cprx(G_BUS_TYPE_SYSTEM, config_path);
-                cfgname = cprx.GetStringProperty("name");
-            }
-            catch (...)
+            if (cfgnames[i] && !cfgnames[i]->Failed())
             {
-                // Failure is okay here, the profile may be deleted.
+                v = cfgnames[i]->GetResult();
+                cfgname = std::string(g_variant_get_string(v, NULL));
+                g_variant_unref(v);
             }
         }
         catch (DBusException &excp)
@@ -342,7 +714,6 @@ static int cmd_session_list(ParsedArgs args)
 
         std::cout << "        Path: " << sessp << std::endl;
 
-        std::time_t sess_created = sprx.GetUInt64Property("session_created");
         std::cout << "     Created: " << std::asctime(std::localtime(&sess_created));
 
         std::cout << "       Owner: " << owner << std::setw(43 - owner.size())
@@ -657,10 +1028,13 @@ void RegisterCommands_session(Commands& ovpn3)
                                 "Start a new VPN session",
                                 cmd_session_start);
     cmd->AddOption("config", 'c', "CONFIG-FILE", true,
-                   "Configuration file to start directly");
+                   "Configuration file to start directly, or the name of "
+                   "an already imported configuration");
     cmd->AddOption("config-path", 'p', "CONFIG-PATH", true,
                    "Configuration path to an already imported configuration",
                    arghelper_config_paths);
+    cmd->AddOption("timeout", "SECS", true,
+                   "Seconds to wait for the connection (default: 30)");
 
     //
     //  session-manage command
@@ -36,7 +36,6 @@ int main(int argc, char **argv)
     g_unix_signal_add(SIGTERM, stop_handler, main_loop);
 
     IdleCheck::Ptr idle_exit = new IdleCheck(main_loop, std::chrono::minutes(3));
-    idle_exit->SetPollTime(std::chrono::seconds(30));
 
     SessionManagerDBus sessmgr(G_BUS_TYPE_SYSTEM);
     // sessmgr.SetLogFile("/tmp/openvpn3-service-sessionmgr.log");
@@ -310,6 +310,27 @@ public:
     }
 
 
+    /**
+     * Retrieves the session paths available to the calling user, together
+     * with the properties of each session, in a single D-Bus call.
+     *
+     * @param offset  Number of available sessions to skip
+     * @param limit   Maximum number of sessions to return, 0 returns all
+     * @param fields  Properties to retrieve. If empty, all properties
+     *                except 'statistics' are retrieved.
+     *
+     * @return A DBusPropertySnapshotList of session paths and their
+     *         properties
+     */
+    DBusPropertySnapshotList FetchAvailableSessionsDetailed(guint32 offset = 0,
+                                                            guint32 limit = 0,
+                                                            std::vector<std::string> fields = {})
+    {
+        return FetchObjectsDetailed("FetchAvailableSessionsDetailed",
+                                    offset, limit, fields);
+    }
+
+
     /**
      *  Makes the VPN backend client process start the connecting to the
      *  VPN server
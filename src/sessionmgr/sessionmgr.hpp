@@ -33,9 +33,11 @@
 #ifndef OPENVPN3_DBUS_SESSIONMGR_HPP
 #define OPENVPN3_DBUS_SESSIONMGR_HPP
 
+#include <csignal>
 #include <cstring>
 #include <functional>
 #include <ctime>
+#include <memory>
 
 #include "openvpn/common/likely.hpp"
 
@@ -376,6 +378,8 @@ public:
           SessionManagerSignals(dbuscon, objpath),
           remove_callback(remove_callback),
           be_proxy(nullptr),
+          be_peer_conn(nullptr),
+          be_peer_proxy(nullptr),
           recv_log_events(false),
           session_created(std::time(nullptr)),
           config_path(cfg_path),
@@ -383,93 +387,163 @@ public:
           sig_logevent(nullptr),
           backend_token(""),
           backend_pid(0),
+          backend_pid_verified(false),
           be_conn(nullptr),
           log_verb(LogCategory::INFO),
           registered(false),
-          selfdestruct_complete(false)
+          selfdestruct_complete(false),
+          shutdown_phase(ShutdownPhase::NONE),
+          shutdown_forced(false),
+          shutdown_selfdestruct(false),
+          shutdown_timer(nullptr),
+          shutdown_route(0),
+          alive(std::make_shared<bool>(true))
     {
-        Subscribe("RegistrationRequest");
-        RequiresQueue dummyqueue;  // Only used to get introspection data
-
-        // Register configuration the configuration object
-        std::stringstream introspection_xml;
-        introspection_xml << "<node name='" << objpath << "'>"
-                          << "    <interface name='" << OpenVPN3DBus_interf_sessions << "'>"
-                          << "        <method name='Connect'/>"
-                          << "        <method name='Pause'>"
-                          << "            <arg type='s' name='reason' direction='in'/>"
-                          << "        </method>"
-                          << "        <method name='Resume'/>"
-                          << "        <method name='Restart'/>"
-                          << "        <method name='Disconnect'/>"
-                          << "        <method name='Ready'/>"
-                          << "        <method name='AccessGrant'>"
-                          << "            <arg direction='in' type='u' name='uid'/>"
-                          << "        </method>"
-                          << "        <method name='AccessRevoke'>"
-                          << "            <arg direction='in' type='u' name='uid'/>"
-                          << "        </method>"
-                          << dummyqueue.IntrospectionMethods("UserInputQueueGetTypeGroup",
-                                                             "UserInputQueueFetch",
-                                                             "UserInputQueueCheck",
-                                                             "UserInputProvide")
-                          << "        <signal name='AttentionRequired'>"
-                          << "            <arg type='u' name='type' direction='out'/>"
-                          << "            <arg type='u' name='group' direction='out'/>"
-                          << "            <arg type='s' name='message' direction='out'/>"
-                          << "        </signal>"
-                          << GetStatusChangeIntrospection()
-                          << GetLogIntrospection()
-                          << "        <property type='u' name='owner' access='read'/>"
-                          << "        <property type='t' name='session_created' access='read'/>"
-                          << "        <property type='au' name='acl' access='read'/>"
-                          << "        <property type='b' name='public_access' access='readwrite'/>"
-                          << "        <property type='a{sv}' name='status' access='read'/>"
-                          << "        <property type='a{sv}' name='last_log' access='read'/>"
-                          << "        <property type='a{sx}' name='statistics' access='read'/>"
-                          << "        <property type='o' name='config_path' access='read'/>"
-                          << "        <property type='u' name='backend_pid' access='read'/>"
-                          << "        <property type='b' name='receive_log_events' access='readwrite'/>"
-                          << "        <property type='u' name='log_verbosity' access='readwrite'/>"
-                          << "    </interface>"
-                          << "</node>";
-        ParseIntrospectionXML(introspection_xml);
+        prepare_object();
 
-        // Start a new backend process via the openvpn3-service-backendstart
-        // (net.openvpn.v3.backends) service.  A random backend token is
-        // created and sent to the backend process.  When the backend process
+        // A random backend token is created and sent to the backend
+        // process started by StartBackend().  When the backend process
         // have initialized, it reports back to the session manager using
         // this token as a reference.  This is used to tie the backend process
         // to this specific SessionObject.
         backend_token = generate_path_uuid("", 't');
 
-        auto backend_start = new DBusProxy(G_BUS_TYPE_SYSTEM,
-                                           OpenVPN3DBus_name_backends,
-                                           OpenVPN3DBus_interf_backends,
-                                           OpenVPN3DBus_rootp_backends);
-        GVariant *res_g = backend_start->Call("StartClient",
-                                              g_variant_new("(s)", backend_token.c_str()));
-        if (NULL == res_g) {
-                THROW_DBUSEXCEPTION("SessionObject",
-                                    "Failed to extract the result of the "
-                                    "StartClient request");
-        }
-        g_variant_get(res_g, "(u)", &backend_pid);
+        // The RegistrationRequest signal is broadcast.  Only subscribe to
+        // the signal carrying our token, so the signal router does not
+        // pass on the registration requests of other sessions.
+        Subscribe("", "", "RegistrationRequest", 1, backend_token);
 
-        // The PID value we get here is just a temporary.  This is the
-        // PID returned by openvpn3-service-backendstart.  This will again
-        // start the openvpn3-service-client process, which will fork() once
-        // to be completely independent.  When this last fork() happens,
-        // the backend will report back its final PID.
-        StatusChange(StatusMajor::SESSION, StatusMinor::PROC_STARTED,
-                             "session_path=" + GetObjectPath()
-                             + ", backend_pid=" + std::to_string(backend_pid));
         Debug("SessionObject registered on '" + OpenVPN3DBus_interf_sessions + "': "
               + objpath + " [backend_token=" + backend_token + "]");
     }
 
+    /**
+     *  Constructor re-attaching a SessionObject to an already running
+     *  VPN client backend process.  This is used when the session manager
+     *  has been restarted.  The state of the session is restored from the
+     *  session information the session manager previously stored in the
+     *  backend process.  The tunnel itself is not touched.
+     *
+     * @param dbuscon          D-Bus connection this object is tied to
+     * @param be_busname       D-Bus bus name of the backend process
+     * @param be_unique_name   Unique D-Bus bus name of the backend process
+     * @param be_path          D-Bus object path of the backend session
+     * @param session_info     GVariant a{sv} dictionary with the session
+     *                         information retrieved via FetchSessionInfo
+     */
+    SessionObject(GDBusConnection *dbuscon,
+                  std::function<void()> remove_callback,
+                  const std::string be_busname,
+                  const std::string be_unique_name,
+                  const std::string be_path,
+                  GVariant *session_info)
+        : DBusObject(lookup_session_info_string(session_info, "session_path")),
+          DBusSignalSubscription(dbuscon, "", OpenVPN3DBus_interf_backends, ""),
+          DBusCredentials(dbuscon, lookup_session_info_uint32(session_info, "owner")),
+          SessionManagerSignals(dbuscon, GetObjectPath()),
+          remove_callback(remove_callback),
+          be_proxy(nullptr),
+          be_peer_conn(nullptr),
+          be_peer_proxy(nullptr),
+          recv_log_events(false),
+          session_created(std::time(nullptr)),
+          config_path(lookup_session_info_string(session_info, "config_path")),
+          sig_statuschg(nullptr),
+          sig_logevent(nullptr),
+          backend_token(lookup_session_info_string(session_info, "backend_token")),
+          backend_pid(0),
+          backend_pid_verified(false),
+          be_conn(dbuscon),
+          be_busname(be_busname),
+          be_unique_name(be_unique_name),
+          be_path(be_path),
+          be_p2p_address(lookup_session_info_string(session_info, "p2p_address")),
+          log_verb(LogCategory::INFO),
+          registered(false),
+          selfdestruct_complete(false),
+          shutdown_phase(ShutdownPhase::NONE),
+          shutdown_forced(false),
+          shutdown_selfdestruct(false),
+          shutdown_timer(nullptr),
+          shutdown_route(0),
+          alive(std::make_shared<bool>(true))
+    {
+        prepare_object();
+
+        GVariant *v = g_variant_lookup_value(session_info, "session_created",
+                                             G_VARIANT_TYPE_UINT64);
+        if (v)
+        {
+            session_created = (std::time_t) g_variant_get_uint64(v);
+            g_variant_unref(v);
+        }
+        v = g_variant_lookup_value(session_info, "public_access",
+                                   G_VARIANT_TYPE_BOOLEAN);
+        if (v)
+        {
+            SetPublicAccess(g_variant_get_boolean(v));
+            g_variant_unref(v);
+        }
+        v = g_variant_lookup_value(session_info, "acl", G_VARIANT_TYPE("au"));
+        if (v)
+        {
+            GVariantIter *iter = g_variant_iter_new(v);
+            guint32 uid;
+            while (g_variant_iter_next(iter, "u", &uid))
+            {
+                GrantAccess(uid);
+            }
+            g_variant_iter_free(iter);
+            g_variant_unref(v);
+        }
+        v = g_variant_lookup_value(session_info, "log_verbosity",
+                                   G_VARIANT_TYPE_UINT32);
+        if (v)
+        {
+            log_verb = (LogCategory) g_variant_get_uint32(v);
+            g_variant_unref(v);
+        }
+        v = g_variant_lookup_value(session_info, "receive_log_events",
+                                   G_VARIANT_TYPE_BOOLEAN);
+        if (v)
+        {
+            recv_log_events = g_variant_get_boolean(v);
+            g_variant_unref(v);
+        }
+
+        try
+        {
+            backend_pid = GetPID(be_unique_name);
+            backend_pid_verified = true;
+        }
+        catch (DBusException&)
+        {
+            // Not critical; only used for logging and shutdown
+        }
+
+        Subscribe(be_unique_name, be_path, "AttentionRequired");
+        Subscribe(be_unique_name, be_path, "StatusChange");
+        attach_backend();
+        registered = true;
+        open_peer_connection(be_p2p_address);
+        if (recv_log_events)
+        {
+            sig_logevent = new SessionLogEvent(be_conn,
+                                               be_busname,
+                                               OpenVPN3DBus_interf_backends,
+                                               be_path,
+                                               GetObjectPath());
+        }
+        LogVerb1("Session re-attached: " + GetObjectPath()
+                 + " backend_busname=" + be_busname
+                 + " backend_path=" + be_path);
+    }
+
+
     ~SessionObject()
     {
+        *alive = false;
+        stop_shutdown_tracking();
         if (sig_statuschg)
         {
             delete sig_statuschg;
@@ -484,6 +558,7 @@ public:
         {
             delete be_proxy;
         }
+        close_peer_connection();
         LogVerb2("Session is closing");
         StatusChange(StatusMajor::SESSION, StatusMinor::SESS_REMOVED);
         remove_callback();
@@ -491,6 +566,50 @@ public:
     }
 
 
+    /**
+     *  Starts a new backend process via the openvpn3-service-backendstart
+     *  (net.openvpn.v3.backends) service.  The StartClient call is not
+     *  waited for; the NewTunnel call is answered with the path of this
+     *  session object once the backend starter has responded.  If the
+     *  backend process could not be started, an error is returned and
+     *  this object removes itself.
+     *
+     * @param conn   D-Bus connection this object is registered on
+     * @param invoc  GDBusMethodInvocation of the NewTunnel call
+     */
+    void StartBackend(GDBusConnection *conn, GDBusMethodInvocation *invoc)
+    {
+        try
+        {
+            DBusProxy backend_start(G_BUS_TYPE_SYSTEM,
+                                    OpenVPN3DBus_name_backends,
+                                    OpenVPN3DBus_interf_backends,
+                                    OpenVPN3DBus_rootp_backends);
+            std::shared_ptr<bool> alive_ref = alive;
+            backend_start.CallAsync("StartClient",
+                                    g_variant_new("(s)", backend_token.c_str()),
+                                    -1,
+                                    [this, alive_ref, conn, invoc](DBusPendingCall& call)
+                                    {
+                                        if (!*alive_ref)
+                                        {
+                                            // The session was removed meanwhile
+                                            return_start_error(invoc);
+                                            return;
+                                        }
+                                        backend_started(conn, invoc, call);
+                                    });
+        }
+        catch (DBusException& excp)
+        {
+            LogError("Could not start the backend process");
+            Debug(excp.getRawError());
+            return_start_error(invoc);
+            selfdestruct(conn);
+        }
+    }
+
+
     /**
      *  Callback method called each time signals we have subscribed to
      *  occurs.  For the SessionObject, we care about these signals:
@@ -517,85 +636,30 @@ public:
                                  const std::string signal_name,
                                  GVariant *params)
     {
-        if ((signal_name == "RegistrationRequest")
-            && (interface_name == OpenVPN3DBus_interf_backends))
+        // The signals are processed serialized with the method calls,
+        // as they modify the state of this object
+        g_variant_ref(params);
+        bool queued = RunSerialized([this, conn, sender_name, object_path,
+                                     interface_name, signal_name, params]()
+                                    {
+                                        process_signal(conn, sender_name,
+                                                       object_path,
+                                                       interface_name,
+                                                       signal_name, params);
+                                        g_variant_unref(params);
+                                    });
+        if (!queued)
         {
-            gchar *busn;
-            gchar *sesstoken;
-            g_variant_get (params, "(ss)", &busn, &sesstoken);
-
-            be_conn = conn;
-            be_busname = std::string(busn);
-            be_path = std::string(object_path);
-            g_free(busn);
-
-            if (std::string(sesstoken) != backend_token)
-            {
-                // This registration request was not for us.
-                // The RegistrationRequest signals is broadcasted which means
-                // any SessionObject still subscribed to this signal will
-                // see this request.
-                //
-                // This can happen if several tunnels are started in parallel
-                // and they issue this signal at approximately the same time
-                // and before the owning SessionObject() have managed to
-                // unsubscribe from the signal
-
-                // Debug("Ignoring RegistrationRequest (token mismatch)  - name=" + be_busname + ", path=" + be_path);
-                return;
-            }
-
-            try
-            {
-                Subscribe(sender_name, be_path, "AttentionRequired");
-                Subscribe(sender_name, be_path, "StatusChange");
-                register_backend();
-                Unsubscribe("RegistrationRequest");
-            }
-            catch (DBusException& err)
-            {
-                LogError("Could not register backend process, removing session object");
-                Debug(be_busname, be_path, backend_pid, std::string(err.what()));
-                StatusChange(StatusMajor::SESSION, StatusMinor::PROC_KILLED, "Backend process died");
-                selfdestruct(conn);
-            }
-        }
-        else if ((signal_name == "StatusChange")
-                 && (interface_name == OpenVPN3DBus_interf_backends))
-        {
-            guint32 major_u;
-            guint32 minor_u;
-            gchar *msg;
-            g_variant_get (params, "(uus)", &major_u, &minor_u, &msg);
-
-            StatusMajor major = (StatusMajor) major_u;
-            StatusMinor minor = (StatusMinor) minor_u;
-            if (StatusMajor::CONNECTION == major
-                && (StatusMinor::CONN_FAILED == minor
-                    || StatusMinor::CONN_AUTH_FAILED == minor))
-            {
-                // When the backend client signals connection failure
-                // force it to shutdown and close this session object
-                //
-                // FIXME: Consider if we need to split CONN_FAILED into
-                //        a fatal error (as now) and "Connection failed, but session may resume"
-                //        This link is between here and client/core-client.hpp:173
-                //
-                shutdown(true, (StatusMinor::CONN_FAILED == minor));
-            }
-        }
-        else if ((signal_name =="AttentionRequired")
-                 && (interface_name == OpenVPN3DBus_interf_backends))
-        {
-                // Proxy this signal directly to the front-end processes
-                // listening
-                Send("AttentionRequired", params);
+            // This object is being removed
+            g_variant_unref(params);
         }
     }
 
+
     /**
      *  Callback method which is called each time a D-Bus method call occurs
-     *  on this SessionObject.
+     *  on this SessionObject.  The method handlers are bound in
+     *  register_methods().
      *
      *  In most cases the method call is just proxied to the client backend
      *  process after an access control check has been performed.  Many of the
@@ -603,28 +667,26 @@ public:
      *  most sensitive methods are only accessible to the owner of this
      *  session.
      *
-     * @param conn       D-Bus connection where the method call occurred
-     * @param sender     D-Bus bus name of the sender of the method call
-     * @param obj_path   D-Bus object path of the target object.
-     * @param intf_name  D-Bus interface of the method call
-     * @param method_name D-Bus method name to be executed
-     * @param params     GVariant Glib2 object containing the arguments for
-     *                   the method call
-     * @param invoc      GDBusMethodInvocation where the response/result of
-     *                   the method call will be returned.
+     *  Before any method is run, the backend process is checked to be
+     *  alive.  Errors from all the method handlers are handled here.
+     *
+     * @param conn     D-Bus connection where the method call occurred
+     * @param sender   D-Bus bus name of the sender of the method call
+     * @param handler  The method handler to run
+     * @param params   GVariant Glib2 object containing the arguments for
+     *                 the method call
+     * @param invoc    GDBusMethodInvocation where the response/result of
+     *                 the method call will be returned.
      */
-    void callback_method_call(GDBusConnection *conn,
-                              const std::string sender,
-                              const std::string obj_path,
-                              const std::string intf_name,
-                              const std::string method_name,
-                              GVariant *params,
-                              GDBusMethodInvocation *invoc)
+    void callback_method_dispatch(GDBusConnection *conn,
+                                  const gchar *sender,
+                                  const MethodHandler& handler,
+                                  GVariant *params,
+                                  GDBusMethodInvocation *invoc)
     {
-        // std::cout << "SessionObject::callback_method_call: " << method_name << std::endl;
         bool ping = false;
         try {
-            if (!be_proxy)
+            if (!backend())
             {
                 THROW_DBUSEXCEPTION("SessionObject", "No backend proxy connection available. Backend died?");
             }
@@ -644,124 +706,7 @@ public:
                                     + std::string(dbserr.getRawError()));
             }
 
-            if ("Connect" == method_name)
-            {
-                CheckACL(sender);
-                be_proxy->Call("Connect");
-            }
-            else if ("Restart" == method_name)
-            {
-                CheckACL(sender, true);
-                be_proxy->Call("Restart");
-            }
-            else if ("Pause" == method_name)
-            {
-                CheckACL(sender, true);
-                // FIXME: Should check that params contains only the expected formatting
-                be_proxy->Call("Pause", params);
-            }
-            else if ("Resume"  == method_name)
-            {
-                CheckACL(sender, true);
-                be_proxy->Call("Resume");
-            }
-            else if ("Disconnect" == method_name)
-            {
-                CheckACL(sender, true);
-                shutdown(false, true);
-            }
-            else if ("Ready" == method_name)
-            {
-                CheckACL(sender);
-                be_proxy->Call("Ready");
-            }
-            else if ("UserInputQueueGetTypeGroup" == method_name)
-            {
-                CheckACL(sender);
-                try
-                {
-                    GVariant *res = be_proxy->Call("UserInputQueueGetTypeGroup", params);
-                    g_dbus_method_invocation_return_value(invoc, res);
-                    g_variant_unref(res);
-                }
-                catch (RequiresQueueException& excp)
-                {
-                    excp.GenerateDBusError(invoc);
-                }
-                return;
-            }
-            else if ("UserInputQueueFetch" == method_name)
-            {
-                CheckACL(sender);
-                try
-                {
-                    GVariant *res = be_proxy->Call("UserInputQueueFetch", params);
-                    g_dbus_method_invocation_return_value(invoc, res);
-                    g_variant_unref(res);
-                }
-                catch (RequiresQueueException& excp)
-                {
-                    excp.GenerateDBusError(invoc);
-                }
-                return;
-            }
-            else if ("UserInputQueueCheck" == method_name)
-            {
-                CheckACL(sender);
-                GVariant *res = be_proxy->Call("UserInputQueueCheck", params);
-                g_dbus_method_invocation_return_value(invoc, res);
-                g_variant_unref(res);
-                return;
-            }
-            else if ("UserInputProvide" == method_name)
-            {
-                CheckACL(sender);
-                try
-                {
-                    GVariant *res = be_proxy->Call("UserInputProvide", params);
-                    g_dbus_method_invocation_return_value(invoc, res);
-                    g_variant_unref(res);
-                }
-                catch (RequiresQueueException& excp)
-                {
-                    excp.GenerateDBusError(invoc);
-                }
-                return;
-            }
-            else if ("AccessGrant" == method_name)
-            {
-                CheckOwnerAccess(sender);
-
-                uid_t uid = -1;
-                g_variant_get(params, "(u)", &uid);
-                GrantAccess(uid);
-                g_dbus_method_invocation_return_value(invoc, NULL);
-
-                LogVerb1("Access granted to UID " + std::to_string(uid));
-                return;
-            }
-            else if ("AccessRevoke" == method_name)
-            {
-                CheckOwnerAccess(sender);
-
-                uid_t uid = -1;
-                g_variant_get(params, "(u)", &uid);
-                RevokeAccess(uid);
-                g_dbus_method_invocation_return_value(invoc, NULL);
-
-                LogVerb1("Access revoked for UID " + std::to_string(uid));
-                return;
-            }
-            else
-            {
-                std::string errmsg = "No method named" + method_name + " is available";
-                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.sessions.error",
-                                                              errmsg.c_str());
-                g_dbus_method_invocation_return_gerror(invoc, err);
-                g_error_free(err);
-                return;
-            }
-            g_dbus_method_invocation_return_value(invoc, NULL);
+            handler(conn, sender, params, invoc);
         }
         catch (DBusException& dberr)
         {
@@ -859,6 +804,9 @@ public:
                   << ", property=" << property_name
                   << std::endl;
         */
+        // The backend state is modified by the worker threads
+        std::unique_lock<std::mutex> guard(backend_mtx);
+
         GVariant *ret = NULL;
         if ("receive_log_events" == property_name)
         {
@@ -899,7 +847,16 @@ public:
         {
             try
             {
-                ret = be_proxy->GetProperty("statistics");
+                // Don't block the worker threads while waiting for
+                // the backend
+                DBusProxy *be = select_backend();
+                guard.unlock();
+                if (nullptr == be)
+                {
+                    THROW_DBUSEXCEPTION("SessionObject",
+                                        "No backend available");
+                }
+                ret = be->GetProperty("statistics");
             }
             catch (DBusException& exp)
             {
@@ -984,38 +941,55 @@ public:
                                         excp.getUserError());
         }
 
+        // The session information is stored in the backend from the
+        // worker thread, so the main loop does not wait for the backend
+        auto store_info = [this]()
+                          {
+                              store_session_info();
+                          };
+
         if (("receive_log_events" == property_name) && be_conn)
         {
-            recv_log_events = g_variant_get_boolean(value);
-            if (recv_log_events && nullptr == sig_logevent)
-            {
-                // Subscribe to log signals
-                sig_logevent = new SessionLogEvent(
-                                be_conn,
-                                be_busname,
-                                OpenVPN3DBus_interf_backends,
-                                be_path,
-                                GetObjectPath());
-            }
-            else if (!recv_log_events && nullptr != sig_logevent)
+            bool recv_logs = g_variant_get_boolean(value);
             {
-                delete sig_logevent;
-                sig_logevent = nullptr;
+                std::lock_guard<std::mutex> guard(backend_mtx);
+                recv_log_events = recv_logs;
+                if (recv_log_events && nullptr == sig_logevent)
+                {
+                    // Subscribe to log signals
+                    sig_logevent = new SessionLogEvent(
+                                    be_conn,
+                                    be_busname,
+                                    OpenVPN3DBus_interf_backends,
+                                    be_path,
+                                    GetObjectPath());
+                }
+                else if (!recv_log_events && nullptr != sig_logevent)
+                {
+                    delete sig_logevent;
+                    sig_logevent = nullptr;
+                }
             }
-            return build_set_property_response(property_name, recv_log_events);
+            RunSerialized(store_info);
+            return build_set_property_response(property_name, recv_logs);
         }
         else if (("log_verbosity" == property_name) && be_conn)
         {
-            log_verb = (LogCategory) g_variant_get_uint32(value);
+            guint32 verb = g_variant_get_uint32(value);
+            {
+                std::lock_guard<std::mutex> guard(backend_mtx);
+                log_verb = (LogCategory) verb;
+            }
+            RunSerialized(store_info);
 
             // FIXME: Proxy log level to the OpenVPN3 Core client
-            return build_set_property_response(property_name,
-                                               (guint32) log_verb);
+            return build_set_property_response(property_name, verb);
         }
         else if (("public_access" == property_name) && conn)
         {
             bool acl_public = g_variant_get_boolean(value);
             SetPublicAccess(acl_public);
+            RunSerialized(store_info);
             LogVerb1("Public access set to "
                      + (acl_public ? std::string("true") :
                                      std::string("false"))
@@ -1029,43 +1003,514 @@ public:
     }
 
 
+private:
+    std::function<void()> remove_callback;
+    DBusProxy *be_proxy;
+    GDBusConnection *be_peer_conn;
+    DBusProxy *be_peer_proxy;
+    bool recv_log_events;
+    std::time_t session_created;
+    std::string config_path;
+    SessionStatusChange *sig_statuschg;
+    SessionLogEvent *sig_logevent;
+    std::string backend_token;
+    pid_t backend_pid;
+    bool backend_pid_verified;  /**< backend_pid is from the backend's own D-Bus credentials */
+    GDBusConnection *be_conn;
+    std::string be_busname;
+    std::string be_unique_name;
+    std::string be_path;
+    std::string be_p2p_address;
+    LogCategory log_verb;
+    bool registered;
+    bool selfdestruct_complete;
+    std::mutex selfdestruct_guard;
+
+    /**
+     *  Protects the backend proxies, the peer-to-peer connection, the
+     *  backend PID, the log settings and the signal subscriptions.  These
+     *  are set up by the worker threads while the property callbacks use
+     *  them from the main loop.  The lock is never held during a D-Bus
+     *  call.  The subscriptions are only removed by the destructor, which
+     *  runs in the main loop where the signals are dispatched.  The ACL
+     *  is protected by DBusCredentials itself.
+     */
+    std::mutex backend_mtx;
+
+    /**
+     *  Steps of the backend shutdown, see shutdown()
+     */
+    enum class ShutdownPhase {
+        NONE,        /**< No shutdown in progress */
+        REQUESTED,   /**< Disconnect or ForceShutdown sent to the backend */
+        TERMINATED,  /**< SIGTERM sent to the backend process */
+        KILLED       /**< SIGKILL sent to the backend process */
+    };
+
+    /**
+     *  Seconds to wait for the backend to stop before escalating to the
+     *  next shutdown phase
+     */
+    static const guint shutdown_grace_period = 5;
+    static const guint shutdown_term_period = 3;
+    static const guint shutdown_kill_period = 1;
+
+    ShutdownPhase shutdown_phase;
+    bool shutdown_forced;
+    bool shutdown_selfdestruct;
+    GSource *shutdown_timer;
+    guint shutdown_route;
+
+    /**
+     *  Set to false when this object is destroyed.  Pending asynchronous
+     *  calls hold a reference, so their callbacks can detect it.
+     */
+    std::shared_ptr<bool> alive;
+
+
     /**
-     *  Clean-up function triggered by the D-Bus library when an object
-     *  is removed from the D-Bus
+     *  Prepares the D-Bus object.  The introspection data is parsed and
+     *  the method handlers are registered.
      */
-    void callback_destructor ()
+    void prepare_object()
     {
-        if( nullptr != sig_statuschg)
+        RequiresQueue dummyqueue;  // Only used to get introspection data
+
+        // Register configuration the configuration object.  The object
+        // path is not part of the introspection document, which allows all
+        // session objects to share the parsed document
+        std::stringstream introspection_xml;
+        introspection_xml << "<node>"
+                          << "    <interface name='" << OpenVPN3DBus_interf_sessions << "'>"
+                          << "        <method name='Connect'/>"
+                          << "        <method name='Pause'>"
+                          << "            <arg type='s' name='reason' direction='in'/>"
+                          << "        </method>"
+                          << "        <method name='Resume'/>"
+                          << "        <method name='Restart'/>"
+                          << "        <method name='Disconnect'/>"
+                          << "        <method name='Ready'/>"
+                          << "        <method name='AccessGrant'>"
+                          << "            <arg direction='in' type='u' name='uid'/>"
+                          << "        </method>"
+                          << "        <method name='AccessRevoke'>"
+                          << "            <arg direction='in' type='u' name='uid'/>"
+                          << "        </method>"
+                          << dummyqueue.IntrospectionMethods("UserInputQueueGetTypeGroup",
+                                                             "UserInputQueueFetch",
+                                                             "UserInputQueueCheck",
+                                                             "UserInputProvide")
+                          << "        <signal name='AttentionRequired'>"
+                          << "            <arg type='u' name='type' direction='out'/>"
+                          << "            <arg type='u' name='group' direction='out'/>"
+                          << "            <arg type='s' name='message' direction='out'/>"
+                          << "        </signal>"
+                          << GetStatusChangeIntrospection()
+                          << GetLogIntrospection()
+                          << "        <property type='u' name='owner' access='read'/>"
+                          << "        <property type='t' name='session_created' access='read'/>"
+                          << "        <property type='au' name='acl' access='read'/>"
+                          << "        <property type='b' name='public_access' access='readwrite'/>"
+                          << "        <property type='a{sv}' name='status' access='read'/>"
+                          << "        <property type='a{sv}' name='last_log' access='read'/>"
+                          << "        <property type='a{sx}' name='statistics' access='read'/>"
+                          << "        <property type='o' name='config_path' access='read'/>"
+                          << "        <property type='u' name='backend_pid' access='read'/>"
+                          << "        <property type='b' name='receive_log_events' access='readwrite'/>"
+                          << "        <property type='u' name='log_verbosity' access='readwrite'/>"
+                          << "    </interface>"
+                          << "</node>";
+        ParseIntrospectionXML(introspection_xml);
+        register_methods();
+    }
+
+
+    /**
+     *  Retrieve a string value from the session information stored in
+     *  the backend process.  A missing value results in an empty string.
+     *
+     * @param info  GVariant a{sv} dictionary with the session information
+     * @param key   The key to look up
+     */
+    static std::string lookup_session_info_string(GVariant *info,
+                                                  const char *key)
+    {
+        GVariant *v = g_variant_lookup_value(info, key, G_VARIANT_TYPE_STRING);
+        if (!v)
         {
-            delete sig_statuschg;
-            sig_statuschg = nullptr;
+            return "";
         }
+        std::string ret(g_variant_get_string(v, NULL));
+        g_variant_unref(v);
+        return ret;
+    }
+
 
-        if (nullptr != sig_logevent)
+    /**
+     *  Retrieve an uint32 value from the session information stored in
+     *  the backend process.  A missing value results in an exception.
+     *
+     * @param info  GVariant a{sv} dictionary with the session information
+     * @param key   The key to look up
+     */
+    static guint32 lookup_session_info_uint32(GVariant *info, const char *key)
+    {
+        GVariant *v = g_variant_lookup_value(info, key, G_VARIANT_TYPE_UINT32);
+        if (!v)
         {
-            delete sig_logevent;
-            sig_logevent = nullptr;
+            THROW_DBUSEXCEPTION("SessionObject",
+                                "Missing '" + std::string(key)
+                                + "' in the session information");
+        }
+        guint32 ret = g_variant_get_uint32(v);
+        g_variant_unref(v);
+        return ret;
+    }
+
+
+    /**
+     *  Completes the NewTunnel call once the backend starter has
+     *  responded to the StartClient call issued by StartBackend().
+     *
+     * @param conn   D-Bus connection this object is registered on
+     * @param invoc  GDBusMethodInvocation of the NewTunnel call
+     * @param call   DBusPendingCall of the completed StartClient call
+     */
+    void backend_started(GDBusConnection *conn, GDBusMethodInvocation *invoc,
+                         DBusPendingCall& call)
+    {
+        guint32 start_pid = 0;
+        try
+        {
+            GVariant *res_g = call.GetResult();
+            g_variant_get(res_g, "(u)", &start_pid);
+            g_variant_unref(res_g);
+        }
+        catch (DBusException& excp)
+        {
+            LogError("Could not start the backend process");
+            Debug(excp.getRawError());
+            return_start_error(invoc);
+            selfdestruct(conn);
+            return;
+        }
+
+        // The PID value we get here is just a temporary.  This is the
+        // PID returned by openvpn3-service-backendstart.  This will again
+        // start the openvpn3-service-client process, which will fork() once
+        // to be completely independent.  When this last fork() happens,
+        // the backend will report back its final PID.  The backend may
+        // already have registered itself.
+        {
+            std::lock_guard<std::mutex> guard(backend_mtx);
+            if (0 == backend_pid)
+            {
+                backend_pid = (pid_t) start_pid;
+            }
+        }
+        StatusChange(StatusMajor::SESSION, StatusMinor::PROC_STARTED,
+                     "session_path=" + GetObjectPath()
+                     + ", backend_pid=" + std::to_string(start_pid));
+
+        // The backend object will remain "hidden" for the end-user
+        g_dbus_method_invocation_return_value(invoc,
+                                              g_variant_new("(o)",
+                                                            GetObjectPath().c_str()));
+    }
+
+
+    static void return_start_error(GDBusMethodInvocation *invoc)
+    {
+        GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.sessions.error",
+                                                      "Failed to start the VPN backend process");
+        g_dbus_method_invocation_return_gerror(invoc, err);
+        g_error_free(err);
+    }
+
+
+    /**
+     *  Stores the state of this session object in the backend process.
+     *  A restarted session manager uses this to re-attach to the backend
+     *  process.  Errors are only logged, as the session itself works
+     *  without it.
+     */
+    void store_session_info()
+    {
+        if (!registered)
+        {
+            return;
+        }
+
+        GVariantBuilder *b = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+        g_variant_builder_add(b, "{sv}", "session_path",
+                              g_variant_new_string(GetObjectPath().c_str()));
+        g_variant_builder_add(b, "{sv}", "owner", GetOwner());
+        g_variant_builder_add(b, "{sv}", "config_path",
+                              g_variant_new_string(config_path.c_str()));
+        g_variant_builder_add(b, "{sv}", "session_created",
+                              g_variant_new_uint64(session_created));
+        g_variant_builder_add(b, "{sv}", "backend_token",
+                              g_variant_new_string(backend_token.c_str()));
+        g_variant_builder_add(b, "{sv}", "p2p_address",
+                              g_variant_new_string(be_p2p_address.c_str()));
+        g_variant_builder_add(b, "{sv}", "public_access", GetPublicAccess());
+        g_variant_builder_add(b, "{sv}", "acl", GetAccessList());
+        {
+            std::lock_guard<std::mutex> guard(backend_mtx);
+            g_variant_builder_add(b, "{sv}", "receive_log_events",
+                                  g_variant_new_boolean(recv_log_events));
+            g_variant_builder_add(b, "{sv}", "log_verbosity",
+                                  g_variant_new_uint32((guint32) log_verb));
+        }
+        GVariant *info = g_variant_builder_end(b);
+        g_variant_builder_unref(b);
+
+        try
+        {
+            GVariant *res = backend()->Call("StoreSessionInfo",
+                                            g_variant_new("(@a{sv})", info));
+            if (res)
+            {
+                g_variant_unref(res);
+            }
+        }
+        catch (DBusException& excp)
+        {
+            Debug(be_busname, be_path, backend_pid,
+                  "Could not store session information: "
+                  + std::string(excp.what()));
+        }
+    }
+
+
+    /**
+     *  Processes the signals received by callback_signal_handler()
+     */
+    void process_signal(GDBusConnection *conn,
+                        const std::string sender_name,
+                        const std::string object_path,
+                        const std::string interface_name,
+                        const std::string signal_name,
+                        GVariant *params)
+    {
+        if ((signal_name == "RegistrationRequest")
+            && (interface_name == OpenVPN3DBus_interf_backends))
+        {
+            // The signal router only passes on the registration request
+            // carrying the backend_token of this session object
+            gchar *busn;
+            gchar *sesstoken;
+            g_variant_get (params, "(ss)", &busn, &sesstoken);
+
+            be_conn = conn;
+            be_busname = std::string(busn);
+            be_unique_name = sender_name;
+            be_path = std::string(object_path);
+            g_free(busn);
+            g_free(sesstoken);
+
+            // The PID returned by StartClient may belong to an
+            // intermediate process which has already exited.  Use the
+            // PID of the process which registered itself instead.
+            try
+            {
+                pid_t pid = GetPID(sender_name);
+                std::lock_guard<std::mutex> guard(backend_mtx);
+                backend_pid = pid;
+                backend_pid_verified = true;
+            }
+            catch (DBusException&)
+            {
+                // Keep the PID reported by the backend starter.  It is
+                // not used for sending signals, see shutdown_escalate().
+            }
+
+            try
+            {
+                Subscribe(sender_name, be_path, "AttentionRequired");
+                Subscribe(sender_name, be_path, "StatusChange");
+                register_backend();
+                Unsubscribe("RegistrationRequest");
+            }
+            catch (DBusException& err)
+            {
+                LogError("Could not register backend process, removing session object");
+                Debug(be_busname, be_path, backend_pid, std::string(err.what()));
+                StatusChange(StatusMajor::SESSION, StatusMinor::PROC_KILLED, "Backend process died");
+                selfdestruct(conn);
+            }
+        }
+        else if ((signal_name == "StatusChange")
+                 && (interface_name == OpenVPN3DBus_interf_backends))
+        {
+            guint32 major_u;
+            guint32 minor_u;
+            gchar *msg;
+            g_variant_get (params, "(uus)", &major_u, &minor_u, &msg);
+
+            StatusMajor major = (StatusMajor) major_u;
+            StatusMinor minor = (StatusMinor) minor_u;
+            if (StatusMajor::CONNECTION == major
+                && (StatusMinor::CONN_FAILED == minor
+                    || StatusMinor::CONN_AUTH_FAILED == minor))
+            {
+                // When the backend client signals connection failure
+                // force it to shutdown and close this session object
+                //
+                // FIXME: Consider if we need to split CONN_FAILED into
+                //        a fatal error (as now) and "Connection failed, but session may resume"
+                //        This link is between here and client/core-client.hpp:173
+                //
+                shutdown(true, (StatusMinor::CONN_FAILED == minor));
+            }
+        }
+        else if ((signal_name =="AttentionRequired")
+                 && (interface_name == OpenVPN3DBus_interf_backends))
+        {
+                // Proxy this signal directly to the front-end processes
+                // listening
+                Send("AttentionRequired", params);
+        }
+        else if ((signal_name == "ProcessChange")
+                 && (interface_name == OpenVPN3DBus_interf_backends))
+        {
+            guint32 status;
+            gchar *procname;
+            guint32 pid;
+            g_variant_get (params, "(usu)", &status, &procname, &pid);
+            g_free(procname);
+
+            if (StatusMinor::PROC_STOPPED == (StatusMinor) status)
+            {
+                shutdown_completed();
+            }
         }
-    };
+    }
 
 
-private:
-    std::function<void()> remove_callback;
-    DBusProxy *be_proxy;
-    bool recv_log_events;
-    std::time_t session_created;
-    std::string config_path;
-    SessionStatusChange *sig_statuschg;
-    SessionLogEvent *sig_logevent;
-    std::string backend_token;
-    pid_t backend_pid;
-    GDBusConnection *be_conn;
-    std::string be_busname;
-    std::string be_path;
-    LogCategory log_verb;
-    bool registered;
-    bool selfdestruct_complete;
-    std::mutex selfdestruct_guard;
+    /**
+     *  Binds the handlers of all the D-Bus methods of this object.  These
+     *  are run via callback_method_dispatch().
+     */
+    void register_methods()
+    {
+        RegisterMethod("Connect", "()",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+                       {
+                           CheckACL(sender);
+                           backend()->Call("Connect");
+                           g_dbus_method_invocation_return_value(invoc, NULL);
+                       });
+
+        RegisterMethod("Restart", "()",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+                       {
+                           CheckACL(sender, true);
+                           backend()->Call("Restart");
+                           g_dbus_method_invocation_return_value(invoc, NULL);
+                       });
+
+        RegisterMethod("Pause", "(s)",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+                       {
+                           CheckACL(sender, true);
+                           backend()->Call("Pause", params);
+                           g_dbus_method_invocation_return_value(invoc, NULL);
+                       });
+
+        RegisterMethod("Resume", "()",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+                       {
+                           CheckACL(sender, true);
+                           backend()->Call("Resume");
+                           g_dbus_method_invocation_return_value(invoc, NULL);
+                       });
+
+        RegisterMethod("Disconnect", "()",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+                       {
+                           CheckACL(sender, true);
+                           shutdown(false, true);
+
+                           // The object is removed once the backend
+                           // process has stopped; this call returns
+                           // without waiting for that.
+                           g_dbus_method_invocation_return_value(invoc, NULL);
+                       });
+
+        RegisterMethod("Ready", "()",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+                       {
+                           CheckACL(sender);
+                           backend()->Call("Ready");
+                           g_dbus_method_invocation_return_value(invoc, NULL);
+                       });
+
+        // The user input queue methods are all proxied directly
+        // to the backend process, including the response
+        auto queue_proxy = [this](const std::string method)
+        {
+            return [this, method](GDBusConnection *conn, const gchar *sender,
+                                  GVariant *params, GDBusMethodInvocation *invoc)
+                   {
+                       CheckACL(sender);
+                       try
+                       {
+                           GVariant *res = backend()->Call(method, params);
+                           g_dbus_method_invocation_return_value(invoc, res);
+                           g_variant_unref(res);
+                       }
+                       catch (RequiresQueueException& excp)
+                       {
+                           excp.GenerateDBusError(invoc);
+                       }
+                   };
+        };
+        RegisterMethod("UserInputQueueGetTypeGroup", "()",
+                       queue_proxy("UserInputQueueGetTypeGroup"));
+        RegisterMethod("UserInputQueueFetch", "(uuu)",
+                       queue_proxy("UserInputQueueFetch"));
+        RegisterMethod("UserInputQueueCheck", "(uu)",
+                       queue_proxy("UserInputQueueCheck"));
+        RegisterMethod("UserInputProvide", "(uuus)",
+                       queue_proxy("UserInputProvide"));
+
+        RegisterMethod("AccessGrant", "(u)",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+                       {
+                           CheckOwnerAccess(sender);
+
+                           uid_t uid = -1;
+                           g_variant_get(params, "(u)", &uid);
+                           GrantAccess(uid);
+                           store_session_info();
+                           g_dbus_method_invocation_return_value(invoc, NULL);
+
+                           LogVerb1("Access granted to UID " + std::to_string(uid));
+                       });
+
+        RegisterMethod("AccessRevoke", "(u)",
+                       [this](GDBusConnection *conn, const gchar *sender,
+                              GVariant *params, GDBusMethodInvocation *invoc)
+                       {
+                           CheckOwnerAccess(sender);
+
+                           uid_t uid = -1;
+                           g_variant_get(params, "(u)", &uid);
+                           RevokeAccess(uid);
+                           store_session_info();
+                           g_dbus_method_invocation_return_value(invoc, NULL);
+
+                           LogVerb1("Access revoked for UID " + std::to_string(uid));
+                       });
+    }
 
 
     /**
@@ -1078,25 +1523,9 @@ private:
     {
         try
         {
-            be_proxy = new DBusProxy(G_BUS_TYPE_SYSTEM,
-                                     be_busname,
-                                     OpenVPN3DBus_interf_backends,
-                                     be_path);
-            // Don't try to auto start backend services over D-Bus,
-            // The backend service should exists _before_ we try to
-            // communicate with it.
-            be_proxy->SetGDBusCallFlags(G_DBUS_CALL_FLAGS_NO_AUTO_START);
-            ping_backend();
-
-            // Setup signal listeneres from the backend process
-            // FIXME: Verify how this is related to the subscrition in the caller function
-            sig_statuschg = new SessionStatusChange(be_conn,
-                                                    be_busname,
-                                                    OpenVPN3DBus_interf_backends,
-                                                    be_path,
-                                                    GetObjectPath());
-
-            GVariant *res_g = be_proxy->Call("RegistrationConfirmation",
+            attach_backend();
+
+            GVariant *res_g = backend()->Call("RegistrationConfirmation",
                                              g_variant_new("(so)",
                                                            backend_token.c_str(),
                                                            config_path.c_str()));
@@ -1105,12 +1534,21 @@ private:
                                     "Failed to extract the result of the "
                                     "RegistrationConfirmation response");
             }
-            g_variant_get(res_g, "(b)", &registered);
+            gboolean reg_ok = FALSE;
+            gchar *p2p_address = nullptr;
+            g_variant_get(res_g, "(bs)", &reg_ok, &p2p_address);
+            g_variant_unref(res_g);
+            registered = reg_ok;
             if (!registered)
             {
                 // FIXME: Find a way to gracefully handle failed registration
+                g_free(p2p_address);
                 return;
             }
+            be_p2p_address = std::string(p2p_address);
+            g_free(p2p_address);
+            open_peer_connection(be_p2p_address);
+            store_session_info();
             LogVerb1("New session registered: " + GetObjectPath());
             StatusChange(StatusMajor::SESSION, StatusMinor::SESS_NEW,
                          "session_path=" + GetObjectPath()
@@ -1124,6 +1562,135 @@ private:
     }
 
 
+    /**
+     *  Sets up the proxy to the VPN client backend process and starts
+     *  tracking its status changes.
+     */
+    void attach_backend()
+    {
+        DBusProxy *proxy = new DBusProxy(G_BUS_TYPE_SYSTEM,
+                                         be_busname,
+                                         OpenVPN3DBus_interf_backends,
+                                         be_path);
+        // Don't try to auto start backend services over D-Bus,
+        // The backend service should exists _before_ we try to
+        // communicate with it.
+        proxy->SetGDBusCallFlags(G_DBUS_CALL_FLAGS_NO_AUTO_START);
+        {
+            std::lock_guard<std::mutex> guard(backend_mtx);
+            be_proxy = proxy;
+        }
+        ping_backend();
+
+        // Setup signal listeneres from the backend process
+        // FIXME: Verify how this is related to the subscrition in the caller function
+        auto *statuschg = new SessionStatusChange(be_conn,
+                                                  be_busname,
+                                                  OpenVPN3DBus_interf_backends,
+                                                  be_path,
+                                                  GetObjectPath());
+        std::lock_guard<std::mutex> guard(backend_mtx);
+        sig_statuschg = statuschg;
+    }
+
+
+    /**
+     *  Opens the private peer-to-peer connection to the backend process,
+     *  offered in the RegistrationConfirmation response.  Method calls and
+     *  property lookups on the backend will then not pass the D-Bus
+     *  daemon.  If the connection cannot be established, the system bus
+     *  is used.
+     *
+     * @param address  std::string with the D-Bus address of the backend
+     *                 peer-to-peer server.  If empty, the backend does not
+     *                 offer a peer-to-peer connection.
+     */
+    void open_peer_connection(const std::string& address)
+    {
+        if (address.empty())
+        {
+            return;
+        }
+
+        try
+        {
+            GDBusConnection *peer_conn = DBusPeerServer::Connect(address);
+            {
+                std::lock_guard<std::mutex> guard(backend_mtx);
+                be_peer_conn = peer_conn;
+            }
+            auto *peer_proxy = new DBusProxy(peer_conn,
+                                             "",
+                                             OpenVPN3DBus_interf_backends,
+                                             be_path);
+            {
+                std::lock_guard<std::mutex> guard(backend_mtx);
+                be_peer_proxy = peer_proxy;
+            }
+            Debug("Peer-to-peer connection established to backend: "
+                  + address);
+        }
+        catch (DBusException& excp)
+        {
+            LogWarn("Could not establish peer-to-peer connection to the "
+                    "backend, using the system bus");
+            Debug(be_busname, be_path, backend_pid, excp.getRawError());
+            close_peer_connection();
+        }
+    }
+
+
+    /**
+     *  Closes the peer-to-peer connection to the backend process, if
+     *  established.
+     */
+    void close_peer_connection()
+    {
+        std::lock_guard<std::mutex> guard(backend_mtx);
+        if (be_peer_proxy)
+        {
+            delete be_peer_proxy;
+            be_peer_proxy = nullptr;
+        }
+
+        if (be_peer_conn)
+        {
+            // The pooled proxies keeps the connection alive
+            DBusProxyPool::Get().EvictConnection(be_peer_conn);
+            g_dbus_connection_close(be_peer_conn, NULL, NULL, NULL);
+            g_object_unref(be_peer_conn);
+            be_peer_conn = nullptr;
+        }
+    }
+
+
+    /**
+     *  Retrieve the proxy to use for the backend process.  The
+     *  peer-to-peer connection is preferred, if established and still
+     *  open.
+     *
+     * @return  Returns a pointer to the DBusProxy to use
+     */
+    DBusProxy * backend()
+    {
+        std::lock_guard<std::mutex> guard(backend_mtx);
+        return select_backend();
+    }
+
+
+    /**
+     *  Same as backend(), but the caller must hold backend_mtx
+     */
+    DBusProxy * select_backend()
+    {
+        if (be_peer_proxy && !g_dbus_connection_is_closed(be_peer_conn))
+        {
+            return be_peer_proxy;
+        }
+        return be_proxy;
+    }
+
+
     /**
      * Simple ping-pong game between this SessionObject and its VPN client
      * backend.  If the backend does not respond, we treat it as dead and will
@@ -1133,7 +1700,8 @@ private:
      */
     bool ping_backend()
     {
-        if (nullptr == be_proxy)
+        DBusProxy *be = backend();
+        if (nullptr == be)
         {
             THROW_DBUSEXCEPTION("SessionObject",
                                 "No backend proxy connection established, "
@@ -1142,7 +1710,7 @@ private:
 
         GVariant *res_g = NULL;
         try {
-            res_g = be_proxy->Call("Ping");
+            res_g = be->Call("Ping");
         }
         catch (DBusException &dbserr)
         {
@@ -1163,7 +1731,11 @@ private:
     }
 
     /**
-     *  Initiate a shutdown of the VPN client backend process.
+     *  Initiate a shutdown of the VPN client backend process.  This does
+     *  not block.  The backend is asked to disconnect, and if it has not
+     *  stopped within shutdown_grace_period seconds, SIGTERM and later
+     *  SIGKILL is sent to the backend process.  The SESSION status change
+     *  is sent once the backend process has stopped.
      *
      * @param forced             If set to True, it will not do a normal
      *                           disconnect but tell the backend process
@@ -1176,12 +1748,157 @@ private:
      */
     void shutdown(bool forced, bool selfdestruct_flag)
     {
-        be_proxy->Call( (!forced ? "Disconnect" : "ForceShutdown"), true );
-        // Wait for child to exit
-        sleep(2); // FIXME: Catch the ProcessChange StatusMinor::PROC_STOPPED signal from backend
+        shutdown_selfdestruct |= selfdestruct_flag;
+        if (ShutdownPhase::NONE != shutdown_phase)
+        {
+            // Shutdown is already in progress.  Only escalate
+            // a normal disconnect to a forced shutdown.
+            if (forced && !shutdown_forced)
+            {
+                shutdown_forced = true;
+                request_backend_shutdown();
+            }
+            return;
+        }
+
+        DBusProxy *be = backend();
+        if (nullptr == be)
+        {
+            // No backend has been registered; nothing to wait for
+            shutdown_forced = forced;
+            shutdown_phase = ShutdownPhase::REQUESTED;
+            shutdown_completed();
+            return;
+        }
+
+        // Watch for the backend process to stop.  Either the backend
+        // signals PROC_STOPPED or its D-Bus connection goes away.
+        shutdown_forced = forced;
+        shutdown_phase = ShutdownPhase::REQUESTED;
+        Subscribe(be_unique_name, be_path, "ProcessChange");
+        if (!be_unique_name.empty())
+        {
+            shutdown_route = DBusSignalRouter::Get().AddRoute(
+                                         DBusSignalSubscription::GetConnection(),
+                                         "org.freedesktop.DBus",
+                                         "/org/freedesktop/DBus",
+                                         "org.freedesktop.DBus",
+                                         "NameOwnerChanged",
+                                         [this](GDBusConnection *c,
+                                                const std::string sender_name,
+                                                const std::string obj_path,
+                                                const std::string intf_name,
+                                                const std::string sig_name,
+                                                GVariant *params)
+                                         {
+                                             RunSerialized([this]()
+                                                           {
+                                                               shutdown_completed();
+                                                           });
+                                         },
+                                         0, be_unique_name);
+        }
+        start_shutdown_timer(shutdown_grace_period);
+        request_backend_shutdown();
+    }
+
+
+    /**
+     *  Sends the Disconnect or ForceShutdown request to the backend
+     *  process.  The reply is not waited for; shutdown_completed() is
+     *  called once the backend process has stopped.
+     */
+    void request_backend_shutdown()
+    {
+        try
+        {
+            backend()->Call((!shutdown_forced ? "Disconnect" : "ForceShutdown"),
+                            true);
+        }
+        catch (DBusException& excp)
+        {
+            // The backend might already be gone.  This is caught by
+            // the NameOwnerChanged tracking or the shutdown timer.
+            Debug(be_busname, be_path, backend_pid, excp.getRawError());
+        }
+    }
+
+
+    /**
+     *  Escalates the shutdown when the backend process did not stop in
+     *  time.  First SIGTERM is sent to the backend process, then SIGKILL.
+     *  If the process is gone or still present after SIGKILL, the
+     *  shutdown is considered complete.
+     */
+    void shutdown_escalate()
+    {
+        int sig = 0;
+        guint next_period = 0;
+        switch (shutdown_phase)
+        {
+        case ShutdownPhase::REQUESTED:
+            shutdown_phase = ShutdownPhase::TERMINATED;
+            sig = SIGTERM;
+            next_period = shutdown_term_period;
+            break;
+
+        case ShutdownPhase::TERMINATED:
+            shutdown_phase = ShutdownPhase::KILLED;
+            sig = SIGKILL;
+            next_period = shutdown_kill_period;
+            break;
+
+        case ShutdownPhase::KILLED:
+            shutdown_completed();
+            return;
+
+        default:
+            // The shutdown completed meanwhile
+            return;
+        }
+
+        if (!backend_pid_verified)
+        {
+            // The PID from the backend starter may belong to a process
+            // which has already exited, and it may have been reused
+            LogWarn("Backend process did not stop; its PID is not known, "
+                    "cannot send " + std::string(SIGTERM == sig ? "SIGTERM" : "SIGKILL"));
+            shutdown_completed();
+            return;
+        }
+
+        if (0 >= backend_pid || 0 != kill(backend_pid, sig))
+        {
+            // Without a valid PID, or if the process has already
+            // disappeared, there is nothing more to do
+            shutdown_completed();
+            return;
+        }
+        LogWarn("Backend process (pid " + std::to_string(backend_pid)
+                + ") did not stop, sent "
+                + (SIGTERM == sig ? "SIGTERM" : "SIGKILL"));
+        start_shutdown_timer(next_period);
+    }
+
+
+    /**
+     *  Completes the shutdown started by shutdown() when the backend
+     *  process has stopped.  The status change is sent to the front-ends
+     *  and the session object is removed if requested.
+     */
+    void shutdown_completed()
+    {
+        if (ShutdownPhase::NONE == shutdown_phase)
+        {
+            // No shutdown in progress or already completed
+            return;
+        }
+        bool killed = (shutdown_forced
+                       || ShutdownPhase::REQUESTED != shutdown_phase);
+        stop_shutdown_tracking();
+        shutdown_phase = ShutdownPhase::NONE;
 
-        // Remove this session object
-        if (!forced)
+        if (!killed)
         {
             StatusChange(StatusMajor::SESSION, StatusMinor::PROC_STOPPED, "Session closed");
         }
@@ -1190,13 +1907,74 @@ private:
             StatusChange(StatusMajor::SESSION, StatusMinor::PROC_KILLED, "Session closed, killed backend client");
         }
 
-        if (selfdestruct_flag)
+        if (shutdown_selfdestruct)
         {
             selfdestruct(DBusSignalSubscription::GetConnection());
         }
     }
 
 
+    /**
+     *  Removes the timer and signal subscriptions used to track the
+     *  backend process during shutdown
+     */
+    void stop_shutdown_tracking()
+    {
+        stop_shutdown_timer();
+        if (shutdown_route > 0)
+        {
+            DBusSignalRouter::Get().RemoveRoute(shutdown_route);
+            shutdown_route = 0;
+        }
+        if (ShutdownPhase::NONE != shutdown_phase)
+        {
+            Unsubscribe("ProcessChange");
+        }
+    }
+
+
+    /**
+     *  Starts the timer running shutdown_escalate() in the main loop
+     *
+     * @param seconds  Number of seconds until the timer expires
+     */
+    void start_shutdown_timer(guint seconds)
+    {
+        stop_shutdown_timer();
+        shutdown_timer = g_timeout_source_new_seconds(seconds);
+        g_source_set_callback(shutdown_timer, _cb_shutdown_timeout,
+                              this, NULL);
+        g_source_attach(shutdown_timer, NULL);
+    }
+
+
+    void stop_shutdown_timer()
+    {
+        if (shutdown_timer)
+        {
+            // Destroying an already expired source is harmless, as we
+            // still hold a reference to it
+            g_source_destroy(shutdown_timer);
+            g_source_unref(shutdown_timer);
+            shutdown_timer = nullptr;
+        }
+    }
+
+
+    static gboolean _cb_shutdown_timeout(gpointer this_ptr)
+    {
+        SessionObject *obj = (SessionObject *) this_ptr;
+
+        // The escalation is serialized with the other work on this
+        // object, which may run in a worker thread
+        obj->RunSerialized([obj]()
+                           {
+                               obj->shutdown_escalate();
+                           });
+        return G_SOURCE_REMOVE;
+    }
+
+
     /**
      *  This method is dangerous and should only be used by either the
      *  SessionObject::shutdown() method or exception handlers in the
@@ -1229,7 +2007,22 @@ private:
         RemoveObject(conn);
         selfdestruct_complete = true;
 
-        delete this;
+        // A worker thread may still be using this object, which is
+        // typically the thread calling this method.  Once the worker
+        // is done, this object is deleted from the main loop, which is
+        // also where the signals subscribed to are dispatched.
+        RunWhenIdle([this]()
+                    {
+                        g_idle_add(_cb_deferred_delete, this);
+                    });
+    }
+
+
+    static gboolean _cb_deferred_delete(gpointer this_ptr)
+    {
+        SessionObject *obj = (SessionObject *) this_ptr;
+        delete obj;
+        return G_SOURCE_REMOVE;
     }
 };
 
@@ -1257,7 +2050,8 @@ public:
         : DBusObject(objpath),
           SessionManagerSignals(dbuscon, objpath),
           dbuscon(dbuscon),
-          creds(dbuscon)
+          creds(dbuscon),
+          worker_pool(new DBusWorkerPool(4))
     {
         std::stringstream introspection_xml;
         introspection_xml << "<node name='" << objpath << "'>"
@@ -1269,6 +2063,12 @@ public:
                           << "        <method name='FetchAvailableSessions'>"
                           << "          <arg type='ao' name='paths' direction='out'/>"
                           << "        </method>"
+                          << "        <method name='FetchAvailableSessionsDetailed'>"
+                          << "          <arg type='u' name='offset' direction='in'/>"
+                          << "          <arg type='u' name='limit' direction='in'/>"
+                          << "          <arg type='as' name='fields' direction='in'/>"
+                          << "          <arg type='a(oa{sv})' name='sessions' direction='out'/>"
+                          << "        </method>"
                           << GetLogIntrospection()
                           << "    </interface>"
                           << "</node>";
@@ -1294,6 +2094,74 @@ public:
         SessionManagerSignals::OpenLogFile(filename);
     }
 
+
+    /**
+     *  Re-attaches session objects to VPN client backend processes which
+     *  are still running.  This is used when the session manager starts
+     *  up again after having been stopped or having crashed while VPN
+     *  sessions were running.
+     *
+     *  All backend processes are found via their well-known bus name
+     *  prefix.  Each backend session object is asked for the session
+     *  information stored by the previous session manager instance.
+     *  Backends which cannot be re-attached are left alone.
+     */
+    void ReattachSessions()
+    {
+        std::vector<std::string> busnames;
+        DBusProxy dbusd(dbuscon, "org.freedesktop.DBus",
+                        "org.freedesktop.DBus", "/org/freedesktop/DBus");
+        try
+        {
+            GVariant *res = dbusd.Call("ListNames");
+            GVariantIter *names = NULL;
+            g_variant_get(res, "(as)", &names);
+            gchar *name = NULL;
+            while (g_variant_iter_next(names, "s", &name))
+            {
+                std::string n(name);
+                g_free(name);
+                if (0 == n.find(OpenVPN3DBus_name_backends_be))
+                {
+                    busnames.push_back(n);
+                }
+            }
+            g_variant_iter_free(names);
+            g_variant_unref(res);
+        }
+        catch (DBusException& excp)
+        {
+            LogError("Could not look for running backends: "
+                     + std::string(excp.what()));
+            return;
+        }
+
+        for (const auto& be_busname : busnames)
+        {
+            try
+            {
+                GVariant *res = dbusd.Call("GetNameOwner",
+                                           g_variant_new("(s)",
+                                                         be_busname.c_str()));
+                gchar *owner = NULL;
+                g_variant_get(res, "(s)", &owner);
+                std::string be_unique_name(owner);
+                g_free(owner);
+                g_variant_unref(res);
+
+                for (const auto& be_path : lookup_backend_sessions(be_busname))
+                {
+                    reattach_session(be_busname, be_unique_name, be_path);
+                }
+            }
+            catch (DBusException& excp)
+            {
+                LogWarn("Could not re-attach backend " + be_busname + ": "
+                        + std::string(excp.what()));
+            }
+        }
+    }
+
     /**
      *  Callback method called each time a method in the SessionManagerObject
      *  is called over the D-Bus.
@@ -1344,12 +2212,13 @@ public:
                                                        config_path);
             IdleCheck_RefInc();
             session->IdleCheck_Register(IdleCheck_Get());
+            session->EnableWorkerPool(worker_pool);
             session->RegisterObject(conn);
             session_objects[sesspath] = session;
 
-            // Return the path to the new session object object to the caller
-            // The backend object will remind "hidden" for the end-user
-            g_dbus_method_invocation_return_value(invoc, g_variant_new("(o)", sesspath.c_str()));
+            // The path to the new session object is returned to the
+            // caller once the backend process has been started
+            session->StartBackend(conn, invoc);
         }
         else if ("FetchAvailableSessions" == method_name)
         {
@@ -1382,6 +2251,64 @@ public:
             g_variant_builder_unref(bld);
             g_variant_builder_unref(ret);
         }
+        else if ("FetchAvailableSessionsDetailed" == method_name)
+        {
+            // Retrieve paging information and the properties to include
+            guint32 offset = 0;
+            guint32 limit = 0;
+            GVariantIter *fields_it = NULL;
+            g_variant_get(params, "(uuas)", &offset, &limit, &fields_it);
+
+            std::vector<std::string> fields;
+            gchar *field = NULL;
+            while (g_variant_iter_next(fields_it, "s", &field))
+            {
+                fields.push_back(std::string(field));
+                g_free(field);
+            }
+            g_variant_iter_free(fields_it);
+
+            // The statistics property requires a call to the backend
+            // process; only include it when explicitly requested
+            std::vector<std::string> exclude = {"statistics"};
+
+            // Build up an array of object paths and the property values of
+            // each object the caller is granted access to.  The offset and
+            // limit applies to the list of accessible objects only.
+            GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("a(oa{sv})"));
+            guint32 idx = 0;
+            guint32 count = 0;
+            for (auto& item : session_objects)
+            {
+                if (limit > 0 && count >= limit)
+                {
+                    break;
+                }
+
+                try {
+                    item.second->CheckACL(sender);
+                }
+                catch (DBusCredentialsException& excp)
+                {
+                    // Ignore credentials exceptions.  It means the
+                    // caller does not have access this object
+                    continue;
+                }
+
+                if (idx++ < offset)
+                {
+                    continue;
+                }
+                g_variant_builder_add(bld, "(o@a{sv})", item.first.c_str(),
+                                      item.second->GetPropertyDict(conn, sender,
+                                                                   fields,
+                                                                   exclude));
+                count++;
+            }
+            g_dbus_method_invocation_return_value(invoc,
+                                                  g_variant_new("(a(oa{sv}))", bld));
+            g_variant_builder_unref(bld);
+        }
     };
 
 
@@ -1458,6 +2385,115 @@ public:
 private:
     GDBusConnection *dbuscon;
     DBusConnectionCreds creds;
+    DBusWorkerPool::Ptr worker_pool;
+
+
+    /**
+     *  Retrieve the session object paths of a backend process, via
+     *  D-Bus introspection
+     *
+     * @param be_busname  D-Bus bus name of the backend process
+     *
+     * @return  Returns a std::vector<std::string> with object paths
+     */
+    std::vector<std::string> lookup_backend_sessions(const std::string& be_busname)
+    {
+        DBusProxy prx(dbuscon, be_busname,
+                      "org.freedesktop.DBus.Introspectable",
+                      OpenVPN3DBus_rootp_backends_sessions);
+        prx.SetGDBusCallFlags(G_DBUS_CALL_FLAGS_NO_AUTO_START);
+        GVariant *res = prx.Call("Introspect");
+        gchar *xml = NULL;
+        g_variant_get(res, "(s)", &xml);
+        g_variant_unref(res);
+
+        GError *error = NULL;
+        GDBusNodeInfo *node = g_dbus_node_info_new_for_xml(xml, &error);
+        g_free(xml);
+        if (!node || error)
+        {
+            std::string errmsg = (error ? error->message : "(unknown)");
+            if (error)
+            {
+                g_error_free(error);
+            }
+            THROW_DBUSEXCEPTION("SessionManagerObject",
+                                "Failed to parse backend introspection data: "
+                                + errmsg);
+        }
+
+        std::vector<std::string> paths;
+        for (GDBusNodeInfo **n = node->nodes; n && *n; n++)
+        {
+            paths.push_back(OpenVPN3DBus_rootp_backends_sessions + "/"
+                            + std::string((*n)->path));
+        }
+        g_dbus_node_info_unref(node);
+        return paths;
+    }
+
+
+    /**
+     *  Creates a new SessionObject for a running backend session and
+     *  registers it on the D-Bus
+     *
+     * @param be_busname      D-Bus bus name of the backend process
+     * @param be_unique_name  Unique D-Bus bus name of the backend process
+     * @param be_path         D-Bus object path of the backend session
+     */
+    void reattach_session(const std::string& be_busname,
+                          const std::string& be_unique_name,
+                          const std::string& be_path)
+    {
+        DBusProxy prx(dbuscon, be_busname, OpenVPN3DBus_interf_backends,
+                      be_path);
+        prx.SetGDBusCallFlags(G_DBUS_CALL_FLAGS_NO_AUTO_START);
+        GVariant *res = prx.Call("FetchSessionInfo");
+        GVariant *info = g_variant_get_child_value(res, 0);
+        g_variant_unref(res);
+
+        SessionObject *session = nullptr;
+        try
+        {
+            std::string sesspath;
+            GVariant *v = g_variant_lookup_value(info, "session_path",
+                                                 G_VARIANT_TYPE_STRING);
+            if (v)
+            {
+                sesspath = std::string(g_variant_get_string(v, NULL));
+                g_variant_unref(v);
+            }
+            if (sesspath.empty() || session_objects.find(sesspath) != session_objects.end())
+            {
+                THROW_DBUSEXCEPTION("SessionManagerObject",
+                                    "Invalid session information in " + be_path);
+            }
+
+            auto callback = [self=Ptr(this), sesspath](void)
+                            {
+                                self->remove_session_object(sesspath);
+                            };
+            session = new SessionObject(dbuscon, callback,
+                                        be_busname, be_unique_name, be_path,
+                                        info);
+            g_variant_unref(info);
+            info = nullptr;
+
+            IdleCheck_RefInc();
+            session->IdleCheck_Register(IdleCheck_Get());
+            session->EnableWorkerPool(worker_pool);
+            session->RegisterObject(dbuscon);
+            session_objects[sesspath] = session;
+        }
+        catch (DBusException&)
+        {
+            if (info)
+            {
+                g_variant_unref(info);
+            }
+            throw;
+        }
+    }
     std::map<std::string, SessionObject *> session_objects;
 
     void remove_session_object(const std::string sesspath)
@@ -1535,6 +2571,10 @@ public:
         {
             managobj->IdleCheck_Register(idle_checker);
         }
+
+        // Pick up VPN sessions still running from a previous
+        // session manager instance
+        managobj->ReattachSessions();
     };
 
 
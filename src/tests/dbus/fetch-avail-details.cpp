@@ -0,0 +1,63 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2018      OpenVPN, Inc. <sales@openvpn.net>
+//  Copyright (C) 2018      David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   fetch-avail-details.cpp
+ *
+ * @brief  Prints all available configuration and session paths with
+ *         their names and owners, retrieved via the bulk
+ *         FetchAvailableConfigsDetailed and FetchAvailableSessionsDetailed
+ *         methods.  Optional arguments: offset and limit
+ */
+
+#include <iostream>
+
+#include "dbus/core.hpp"
+#include "configmgr/proxy-configmgr.hpp"
+#include "sessionmgr/proxy-sessionmgr.hpp"
+
+int main(int argc, char **argv)
+{
+    guint32 offset = (argc > 1 ? std::stoi(argv[1]) : 0);
+    guint32 limit = (argc > 2 ? std::stoi(argv[2]) : 0);
+
+    OpenVPN3ConfigurationProxy cfgproxy(G_BUS_TYPE_SYSTEM,
+                                        OpenVPN3DBus_rootp_configuration);
+    std::cout << "Configurations:" << std::endl;
+    for (auto& cfg : cfgproxy.FetchAvailableConfigsDetailed(offset, limit,
+                                                            {"name", "owner"}))
+    {
+        std::cout << "    " << cfg.first
+                  << "  name=" << cfg.second.GetStringProperty("name")
+                  << ", owner=" << cfg.second.GetUIntProperty("owner")
+                  << std::endl;
+    }
+
+    OpenVPN3SessionProxy sessproxy(G_BUS_TYPE_SYSTEM,
+                                   OpenVPN3DBus_rootp_sessions);
+    std::cout << "Sessions:" << std::endl;
+    for (auto& sess : sessproxy.FetchAvailableSessionsDetailed(offset, limit))
+    {
+        std::cout << "    " << sess.first
+                  << "  config_path=" << sess.second.GetStringProperty("config_path")
+                  << ", owner=" << sess.second.GetUIntProperty("owner")
+                  << std::endl;
+    }
+    return 0;
+}
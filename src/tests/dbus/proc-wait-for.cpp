@@ -27,6 +27,7 @@
  *         well as a numeric reference to the PROC_* event to listen for.
  */
 
+#include <future>
 #include <iostream>
 #include <string.h>
 
@@ -41,29 +42,47 @@ struct app_data
     const char *processname;
     const StatusMinor status;
     GMainLoop *mainloop;
-    bool main_running;
     DBus *dbus;
 };
 
-void * wait_for_process_loop(gpointer data)
-{
-    struct app_data *appdata = (struct app_data *) data;
 
+/**
+ *  Waits for the process signal without blocking the main context, which
+ *  is iterated here until the signal arrives or the program is stopped.
+ *  The ProcessSignalWatcher dispatches both the signals and its own
+ *  timeouts via this context.
+ */
+static void wait_for_process_loop(struct app_data *appdata,
+                                  ProcessSignalProducer& procprod)
+{
     ProcessSignalWatcher procsub(appdata->dbus->GetConnection());
+    bool started_sent = false;
     StatusMinor res = StatusMinor::UNSET;
     do {
         std::cout << "Waiting for the process signal to happen (timeout 10 seconds)" << std::endl;
-        res = procsub.WaitForProcess(std::string(appdata->interface), std::string(appdata->processname));
+        std::future<StatusMinor> result = procsub.WaitForProcessAsync(std::string(appdata->interface), std::string(appdata->processname));
+        if (!started_sent)
+        {
+            // Sent once the watcher is subscribed, so it can be caught
+            procprod.ProcessChange(StatusMinor::PROC_STARTED);
+            started_sent = true;
+        }
+
+        while (g_main_loop_is_running(appdata->mainloop)
+               && std::future_status::ready != result.wait_for(std::chrono::seconds(0)))
+        {
+            g_main_context_iteration(NULL, TRUE);
+        }
+        if (!g_main_loop_is_running(appdata->mainloop))
+        {
+            break;
+        }
+        res = result.get();
         std::cout << "status(" << std::to_string((uint8_t) appdata->status) << ") == "
                   << "res(" << std::to_string((uint8_t) res) << ") is "
                   << (res == appdata->status ? "True" : "False") << std::endl;
         std::cout << "Caught : " << StatusMinor_str[(uint8_t) res] << std::endl;
-    } while (((uint8_t) res != (uint8_t) appdata->status)
-             && appdata->main_running != false );
-
-    g_main_loop_quit(appdata->mainloop);
-    g_thread_exit(0);
-    return NULL;
+    } while ((uint8_t) res != (uint8_t) appdata->status);
 }
 
 int main(int argc, char **argv)
@@ -88,26 +107,21 @@ int main(int argc, char **argv)
         .interface = argv[1],
         .processname = argv[2],
         .status  = (StatusMinor) atoi(argv[3]),
-        .mainloop = g_main_loop_new(NULL, FALSE),
-        .main_running = true,
+        .mainloop = g_main_loop_new(NULL, TRUE),
         .dbus = &dbus
     };
 
-    GThread *workerthread = g_thread_new("worker", wait_for_process_loop, &appdata);
-
     ProcessSignalProducer procprod(appdata.dbus->GetConnection(), "net.openvpn.v3.test.progsigs", "proc-wait-for");
 
+    // stop_handler() only marks the main loop as stopped; the loop itself
+    // is never run, wait_for_process_loop() iterates the main context
     g_unix_signal_add(SIGINT, stop_handler, appdata.mainloop);
     g_unix_signal_add(SIGTERM, stop_handler, appdata.mainloop);
 
-    procprod.ProcessChange(StatusMinor::PROC_STARTED);
-    g_main_loop_run(appdata.mainloop);
-    appdata.main_running = false;
+    wait_for_process_loop(&appdata, procprod);
     procprod.ProcessChange(StatusMinor::PROC_STOPPED);
-    usleep(500);
-
-    g_thread_join(workerthread);
-    g_thread_unref(workerthread);
+    g_dbus_connection_flush_sync(appdata.dbus->GetConnection(), NULL, NULL);
+    g_main_loop_unref(appdata.mainloop);
 
    return 0;
 }
@@ -22,7 +22,8 @@
  *
  * @brief  Simple test program reading an OpenVPN configuration file
  *         from stdin, parsing it with OptionListJSON and exporting it
- *         to stdout as JSON.
+ *         to stdout as JSON.  With --compact, the JSON document is
+ *         written without any extra whitespace.
  */
 
 #include <iostream>
@@ -47,6 +48,7 @@ int main(int argc, char **argv)
                       ProfileParseLimits::MAX_DIRECTIVE_SIZE);
     OptionListJSON options;
     options.parse_from_config(conf.str(), &limits);
-    std::cout << options.json_export() << std::endl;
+    bool compact = (argc > 1 && std::string(argv[1]) == "--compact");
+    std::cout << options.json_export(compact) << std::endl;
     return 0;
 }
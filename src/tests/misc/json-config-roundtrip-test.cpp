@@ -0,0 +1,217 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2018         OpenVPN, Inc. <sales@openvpn.net>
+//  Copyright (C) 2018         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   json-config-roundtrip-test.cpp
+ *
+ * @brief  Test program checking that exporting a configuration profile
+ *         with OptionListJSON and importing it again with ProfileMergeJSON
+ *         does not lose or alter any options.  Both the regular and the
+ *         compact JSON format are tested.
+ *
+ *         Without arguments, a set of built-in sample profiles is tested.
+ *         Otherwise each argument is a configuration file to test.
+ */
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <vector>
+#include "common/core-extensions.hpp"
+
+using namespace openvpn;
+
+
+/**
+ *  All arguments of all occurrences of each option, in the order they
+ *  were given.  The order between different options is not preserved
+ *  by the JSON format, so that is not compared.
+ */
+typedef std::map<std::string, std::vector<std::vector<std::string>>> OptionArgs;
+
+
+static const std::vector<std::pair<std::string, std::string>> samples = {
+    {"repeated remote",
+     "client\n"
+     "dev tun\n"
+     "remote vpn1.example.org 1194 udp\n"
+     "proto udp\n"
+     "remote vpn2.example.org 443 tcp\n"
+     "remote vpn3.example.org\n"
+     "remote-random\n"},
+
+    {"multi-argument options",
+     "client\n"
+     "dev tun\n"
+     "remote vpn.example.org 1194\n"
+     "route 10.0.0.0 255.255.0.0 net_gateway\n"
+     "route 192.168.1.0 255.255.255.0\n"
+     "setenv UV_NAME \"Test User\"\n"
+     "setenv FRIENDLY_NAME \"quoted \\\"words\\\" here\"\n"
+     "tls-cipher TLS-ECDHE-RSA-WITH-AES-256-GCM-SHA384\n"
+     "verify-x509-name \"C=NO, O=Example, CN=vpn server\" subject\n"
+     "push-peer-info\n"},
+
+    {"single quoted arguments",
+     "client\n"
+     "dev tun\n"
+     "remote vpn.example.org 1194\n"
+     "verify-x509-name \"CN=vpn server\"\n"
+     "auth-user-pass \"/etc/openvpn/user pass.txt\"\n"
+     "static-challenge \"Enter PIN\"\n"
+     "setenv-safe \"#not a comment\"\n"},
+
+    {"inline blocks",
+     "client\n"
+     "dev tun\n"
+     "remote vpn.example.org 1194\n"
+     "<ca>\n"
+     "-----BEGIN CERTIFICATE-----\n"
+     "MIIBszCCAVmgAwIBAgIJAKZ8Z3k2dGVzdDAKBggqhkjOPQQDAjAWMRQwEgYDVQQD\n"
+     "DAtFeGFtcGxlIENBMB4XDTE4MDEwMTAwMDAwMFoXDTI4MDEwMTAwMDAwMFowFjEU\n"
+     "-----END CERTIFICATE-----\n"
+     "</ca>\n"
+     "key-direction 1\n"
+     "<tls-auth>\n"
+     "-----BEGIN OpenVPN Static key V1-----\n"
+     "e4f2b3c1d0a9f8e7d6c5b4a3f2e1d0c9\n"
+     "-----END OpenVPN Static key V1-----\n"
+     "</tls-auth>\n"},
+};
+
+
+static OptionList::Limits profile_limits()
+{
+    return OptionList::Limits("profile is too large",
+                              ProfileParseLimits::MAX_PROFILE_SIZE,
+                              ProfileParseLimits::OPT_OVERHEAD,
+                              ProfileParseLimits::TERM_OVERHEAD,
+                              ProfileParseLimits::MAX_LINE_SIZE,
+                              ProfileParseLimits::MAX_DIRECTIVE_SIZE);
+}
+
+
+static OptionArgs collect_args(const OptionList& options)
+{
+    OptionArgs ret;
+    for (size_t i = 0; i < options.size(); i++)
+    {
+        const Option& opt = options[i];
+        if (0 == opt.size())
+        {
+            continue;
+        }
+        std::vector<std::string> args;
+        for (size_t j = 1; j < opt.size(); j++)
+        {
+            args.push_back(opt.ref(j));
+        }
+        ret[opt.ref(0)].push_back(args);
+    }
+    return ret;
+}
+
+
+static Json::Value parse_json(const std::string& json)
+{
+    std::stringstream json_stream;
+    json_stream << json;
+    Json::Value data;
+    json_stream >> data;
+    return data;
+}
+
+
+static bool roundtrip(const std::string& descr, const std::string& config,
+                      bool compact)
+{
+    OptionList::Limits limits = profile_limits();
+    OptionListJSON orig;
+    orig.parse_from_config(config, &limits);
+    std::string json = orig.json_export(compact);
+
+    ProfileMergeJSON pm(json);
+    OptionList::Limits reimport_limits = profile_limits();
+    OptionListJSON reimported;
+    reimported.parse_from_config(pm.profile_content(), &reimport_limits);
+
+    bool ok = true;
+    if (collect_args(orig) != collect_args(reimported))
+    {
+        std::cout << "FAIL: " << descr << ": options differ after re-import"
+                  << std::endl;
+        ok = false;
+    }
+    else if (parse_json(reimported.json_export(compact)) != parse_json(json))
+    {
+        std::cout << "FAIL: " << descr << ": JSON export differs after re-import"
+                  << std::endl;
+        ok = false;
+    }
+
+    if (!ok)
+    {
+        std::cout << "---- JSON export ----" << std::endl
+                  << json << std::endl
+                  << "---- Re-imported profile ----" << std::endl
+                  << pm.profile_content() << std::endl;
+        return false;
+    }
+    std::cout << "PASS: " << descr << std::endl;
+    return true;
+}
+
+
+int main(int argc, char **argv)
+{
+    std::vector<std::pair<std::string, std::string>> profiles;
+    if (argc < 2)
+    {
+        profiles = samples;
+    }
+    for (int i = 1; i < argc; i++)
+    {
+        std::ifstream cfgfile(argv[i]);
+        if (!cfgfile)
+        {
+            std::cerr << "** ERROR ** Could not open " << argv[i] << std::endl;
+            return 2;
+        }
+        std::stringstream conf;
+        conf << cfgfile.rdbuf();
+        profiles.push_back(std::make_pair(std::string(argv[i]), conf.str()));
+    }
+
+    unsigned int failed = 0;
+    for (auto& p : profiles)
+    {
+        try
+        {
+            failed += (roundtrip(p.first, p.second, false) ? 0 : 1);
+            failed += (roundtrip(p.first + " (compact)", p.second, true) ? 0 : 1);
+        }
+        catch (std::exception& excp)
+        {
+            std::cout << "FAIL: " << p.first << ": " << excp.what() << std::endl;
+            failed++;
+        }
+    }
+    return (0 == failed ? 0 : 1);
+}